@@ -0,0 +1,516 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "larley/meta-grammar.hpp"
+
+using namespace larley;
+using namespace larley::MetaGrammar;
+
+// Every input is parsed with each way of building the chart and the trees must all be the same, the forest's tree count
+// must also be the number of derivations counted by brute force on the shorter inputs
+// The inputs are random sentences of the grammars and copies of them with a byte changed, most of which don't parse
+// The grammars can't be cyclic, a non-terminal deriving itself has infinitely many trees and none of the extractors stop
+// The grammars are also lexicalized, see StringGrammar::lexicalize, with an action on every rule so that the replaced
+// non-terminals are parsed back and the trees of the inputs that parse must still be the same
+
+struct Case
+{
+    std::string name;
+    std::string rules;
+
+    // Non-terminals that also get an empty rule, the text format can't write one
+    std::vector<GenNT> nullables;
+};
+
+struct Variant
+{
+    std::string name;
+    ParseEngine engine;
+    ChartMode mode;
+};
+
+const std::vector<Variant> variants{
+    {"forest", ParseEngine::Earley, ChartMode::Forest},
+    {"back-pointers", ParseEngine::Earley, ChartMode::BackPointers},
+    {"items", ParseEngine::Earley, ChartMode::Items},
+    {"lr0", ParseEngine::LR0, ChartMode::Items},
+};
+
+constexpr auto many = std::numeric_limits<std::size_t>::max();
+
+std::size_t add(std::size_t a, std::size_t b)
+{
+    return a > many - b ? many : a + b;
+}
+
+std::size_t multiply(std::size_t a, std::size_t b)
+{
+    return a != 0 && b > many / a ? many : a * b;
+}
+
+// Derivations of the whole input, counted by trying every split of every rule, a cycle counts as `many`
+class TreeCounter
+{
+    const Grammar<GenPT>& grammar;
+    std::string_view src;
+
+    static constexpr auto open = many - 1;
+    std::map<std::tuple<GenNT, std::size_t, std::size_t>, std::size_t> symbols;
+
+    std::size_t symbol(const GenNT& product, std::size_t start, std::size_t end)
+    {
+        // Only a nullable symbol derives an empty span, and never through itself, see Grammar::check
+        if (start == end && !grammar.nullables.contains(product))
+        {
+            return 0;
+        }
+
+        const auto key = std::tuple{product, start, end};
+        if (const auto it = symbols.find(key); it != symbols.end())
+        {
+            return it->second == open ? many : it->second;
+        }
+
+        symbols[key] = open;
+
+        std::size_t count = 0;
+        for (const auto& rule : grammar.rules)
+        {
+            if (rule.product == product)
+            {
+                count = add(count, suffix(grammar.ruleToDottedRule[rule.id], start, end));
+            }
+        }
+
+        symbols[key] = count;
+        return count;
+    }
+
+    std::size_t suffix(std::uint32_t dottedRule, std::size_t start, std::size_t end)
+    {
+        const auto* next = grammar.getPostdotSymbol(dottedRule);
+        if (!next)
+        {
+            return start == end ? 1 : 0;
+        }
+
+        if (const auto* terminal = std::get_if<1>(next))
+        {
+            const auto length = StringGrammar::match(src, start, *terminal);
+            return length > 0 && start + length <= end ? suffix(dottedRule + 1, start + length, end) : 0;
+        }
+
+        // The rest first, so that a left recursive symbol is only counted over spans shorter than its own
+        std::size_t count = 0;
+        for (auto split = start; split <= end; split++)
+        {
+            const auto rest = suffix(dottedRule + 1, split, end);
+            if (rest != 0)
+            {
+                count = add(count, multiply(symbol(std::get<0>(*next), start, split), rest));
+            }
+        }
+
+        return count;
+    }
+
+  public:
+    TreeCounter(const Grammar<GenPT>& grammar, std::string_view src) : grammar{grammar}, src{src}
+    {
+    }
+
+    std::size_t count()
+    {
+        return symbol(grammar.startSymbol, 0, src.size());
+    }
+};
+
+// Random sentence of the grammar, the rules closest to a terminal are taken once the depth runs out
+class SentenceMaker
+{
+    const Grammar<GenPT>& grammar;
+    std::mt19937& random;
+
+    // Depth of the shortest derivation of each non-terminal
+    std::map<GenNT, std::size_t> heights;
+
+    std::size_t ruleHeight(const Rule<GenPT>& rule) const
+    {
+        std::size_t height = 0;
+        for (const auto& symbol : rule.symbols)
+        {
+            if (const auto* product = std::get_if<0>(&symbol))
+            {
+                const auto it = heights.find(*product);
+                height = std::max(height, it == heights.end() ? many : it->second);
+            }
+        }
+
+        return height == many ? many : height + 1;
+    }
+
+    void terminal(const StringGrammar::TerminalSymbol& terminal, std::string& out)
+    {
+        if (const auto* literal = std::get_if<StringGrammar::LiteralTerminalSymbol>(&terminal))
+        {
+            out += *literal;
+        }
+        else if (const auto* choice = std::get_if<StringGrammar::ChoiceTerminalSymbol>(&terminal))
+        {
+            out += (*choice)[random() % choice->size()];
+        }
+        else if (const auto* range = std::get_if<StringGrammar::RangeTerminalSymbol>(&terminal))
+        {
+            out += static_cast<char>(range->first[0] + random() % (range->second[0] - range->first[0] + 1));
+        }
+    }
+
+  public:
+    SentenceMaker(const Grammar<GenPT>& grammar, std::mt19937& random) : grammar{grammar}, random{random}
+    {
+        for (bool changed = true; changed;)
+        {
+            changed = false;
+            for (const auto& rule : grammar.rules)
+            {
+                const auto height = ruleHeight(rule);
+                const auto it = heights.find(rule.product);
+                if (height != many && (it == heights.end() || height < it->second))
+                {
+                    heights[rule.product] = height;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    void make(const GenNT& product, std::size_t depth, std::string& out)
+    {
+        std::vector<const Rule<GenPT>*> choices;
+        for (const auto& rule : grammar.rules)
+        {
+            if (rule.product == product && (depth > 0 || ruleHeight(rule) == heights[product]))
+            {
+                choices.push_back(&rule);
+            }
+        }
+
+        for (const auto& symbol : choices[random() % choices.size()]->symbols)
+        {
+            if (const auto* next = std::get_if<0>(&symbol))
+            {
+                make(*next, depth > 0 ? depth - 1 : 0, out);
+            }
+            else
+            {
+                terminal(std::get<1>(symbol), out);
+            }
+        }
+    }
+};
+
+bool sameTree(const ParseTree<GenPT>& a, const ParseTree<GenPT>& b)
+{
+    if (a.size() != b.size())
+    {
+        return false;
+    }
+
+    for (std::size_t x = 0; x < a.size(); x++)
+    {
+        const auto ruleA = a[x].rule ? static_cast<long>(a[x].rule->id) : -1;
+        const auto ruleB = b[x].rule ? static_cast<long>(b[x].rule->id) : -1;
+        if (a[x].start != b[x].start || a[x].end != b[x].end || ruleA != ruleB)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Returns the number of inputs on which the variants disagree
+std::size_t check(const Case& test, std::size_t sentences, std::mt19937& random)
+{
+    auto rules = parseRules(test.rules);
+    assert(rules);
+    for (const auto& product : test.nullables)
+    {
+        rules->push_back({product, {}, 0, 0});
+    }
+
+    const Grammar<GenPT> grammar{rules->front().product, *rules};
+
+    std::vector<Parser<GenPT>> parsers;
+    for (const auto& variant : variants)
+    {
+        auto& parser = parsers.emplace_back(Parser<GenPT>{grammar, StringGrammar::match});
+        parser.engine = variant.engine;
+        parser.chartMode = variant.mode;
+    }
+
+    Semantics<GenPT> semantics;
+    for (const auto& rule : grammar.rules)
+    {
+        semantics.setAction(rule.id, [](auto&) {});
+    }
+
+    Parser<GenPT> lexicalized{StringGrammar::lexicalize(grammar, semantics), StringGrammar::match};
+    const auto replaced = std::ranges::count_if(lexicalized.grammar.expansions, [](const auto& expansion) { return expansion.has_value(); });
+
+    std::vector<std::string> inputs;
+    SentenceMaker maker{grammar, random};
+    for (std::size_t x = 0; x < sentences; x++)
+    {
+        auto& input = inputs.emplace_back();
+        maker.make(grammar.startSymbol, random() % 12, input);
+
+        if (!input.empty())
+        {
+            auto changed = input;
+            changed[random() % changed.size()] = "(+a0 ,]'"[random() % 8];
+            inputs.push_back(std::move(changed));
+        }
+    }
+
+    std::vector<double> chartTimes(variants.size() + 1);
+    std::vector<double> treeTimes(variants.size() + 1);
+    std::size_t complete = 0;
+    std::size_t counted = 0;
+    std::size_t ambiguous = 0;
+    std::size_t mismatches = 0;
+
+    for (const auto& input : inputs)
+    {
+        bool same = true;
+        for (std::size_t x = 0; x < parsers.size(); x++)
+        {
+            auto& parser = parsers[x];
+            parser.src = input;
+            parser.tree = std::nullopt;
+
+            auto start = std::chrono::high_resolution_clock::now();
+            parser.parseChart();
+            auto end = std::chrono::high_resolution_clock::now();
+            chartTimes[x] += std::chrono::duration<double, std::milli>(end - start).count();
+
+            if (parser.chart->matchCount > 0)
+            {
+                start = std::chrono::high_resolution_clock::now();
+                parser.parseTree();
+                end = std::chrono::high_resolution_clock::now();
+                treeTimes[x] += std::chrono::duration<double, std::milli>(end - start).count();
+            }
+
+            const auto& reference = parsers.front();
+            if (parser.chart->matchCount != reference.chart->matchCount || parser.chart->completeMatch != reference.chart->completeMatch ||
+                parser.tree.has_value() != reference.tree.has_value() || (parser.tree && !sameTree(*parser.tree, *reference.tree)))
+            {
+                std::cout << "  " << variants[x].name << " differs from the forest on \"" << input << "\"\n";
+                same = false;
+            }
+        }
+
+        // A prefix can be longer without the replaced non-terminals, only the whole inputs' trees have to be the same
+        {
+            const auto& reference = parsers.front();
+            lexicalized.src = input;
+            lexicalized.tree = std::nullopt;
+
+            auto start = std::chrono::high_resolution_clock::now();
+            lexicalized.parseChart();
+            auto end = std::chrono::high_resolution_clock::now();
+            chartTimes.back() += std::chrono::duration<double, std::milli>(end - start).count();
+
+            const auto parsed = [](const Parser<GenPT>& parser) { return parser.chart->matchCount > 0 && parser.chart->completeMatch; };
+            if (parsed(lexicalized))
+            {
+                start = std::chrono::high_resolution_clock::now();
+                lexicalized.parseTree();
+                end = std::chrono::high_resolution_clock::now();
+                treeTimes.back() += std::chrono::duration<double, std::milli>(end - start).count();
+            }
+
+            if (parsed(lexicalized) != parsed(reference) || (lexicalized.tree && !sameTree(*lexicalized.tree, *reference.tree)))
+            {
+                std::cout << "  lexicalized differs from the forest on \"" << input << "\"\n";
+                same = false;
+            }
+        }
+
+        const auto& forest = parsers.front().chart->forest;
+        if (parsers.front().chart->completeMatch)
+        {
+            complete++;
+
+            const auto trees = forest.countTrees();
+            ambiguous += trees > 1 ? 1 : 0;
+            if (input.size() <= 16)
+            {
+                counted++;
+                if (const auto expected = TreeCounter{grammar, input}.count(); trees != expected)
+                {
+                    std::cout << "  the forest counts " << trees << " trees instead of " << expected << " on \"" << input << "\"\n";
+                    same = false;
+                }
+            }
+        }
+
+        mismatches += same ? 0 : 1;
+    }
+
+    std::cout << test.name << ": " << inputs.size() << " inputs, " << complete << " parsed, " << ambiguous << " ambiguous, " << counted
+              << " tree counts checked, " << mismatches << " mismatches\n";
+    for (std::size_t x = 0; x < variants.size(); x++)
+    {
+        std::cout << "  " << variants[x].name << ": chart " << chartTimes[x] << "ms, tree " << treeTimes[x] << "ms\n";
+    }
+
+    std::cout << "  lexicalized, " << replaced << " symbols replaced: chart " << chartTimes.back() << "ms, tree " << treeTimes.back() << "ms\n";
+
+    return mismatches;
+}
+
+// Inputs deep enough that walking the chart or the tree down by recursion would overflow the stack, each variant parses them
+// and their trees must still be the same
+// The LR(0) recognizer has no Leo items, it's left out of the right recursive ones where it stays quadratic
+std::size_t checkDeep(const std::string& name, const std::string& text, const std::string& input, bool rightRecursive)
+{
+    auto rules = parseRules(text);
+    assert(rules);
+
+    const Grammar<GenPT> grammar{rules->front().product, *rules};
+
+    // A tree's rules point into its parser's grammar, the forest's is kept by rule id once its parser is gone
+    using Edges = std::vector<std::tuple<std::size_t, std::size_t, long>>;
+    const auto edges = [](const ParseTree<GenPT>& tree)
+    {
+        Edges edges;
+        edges.reserve(tree.size());
+        for (const auto& edge : tree)
+        {
+            edges.emplace_back(edge.start, edge.end, edge.rule ? static_cast<long>(edge.rule->id) : -1);
+        }
+
+        return edges;
+    };
+
+    std::size_t mismatches = 0;
+    std::optional<Edges> reference;
+
+    std::cout << name << ": " << input.size() << " bytes\n";
+    for (const auto& variant : variants)
+    {
+        if (rightRecursive && variant.engine == ParseEngine::LR0)
+        {
+            continue;
+        }
+
+        Parser<GenPT> parser{grammar, StringGrammar::match};
+        parser.engine = variant.engine;
+        parser.chartMode = variant.mode;
+        parser.src = input;
+
+        auto start = std::chrono::high_resolution_clock::now();
+        parser.parseChart();
+        auto end = std::chrono::high_resolution_clock::now();
+        const auto chartTime = std::chrono::duration<double, std::milli>(end - start).count();
+
+        start = std::chrono::high_resolution_clock::now();
+        parser.parseTree();
+        end = std::chrono::high_resolution_clock::now();
+        const auto treeTime = std::chrono::duration<double, std::milli>(end - start).count();
+
+        std::cout << "  " << variant.name << ": chart " << chartTime << "ms, tree " << treeTime << "ms\n";
+
+        if (!parser.chart->completeMatch || !parser.tree)
+        {
+            std::cout << "  " << variant.name << " doesn't parse it\n";
+            mismatches++;
+        }
+        else if (!reference)
+        {
+            reference = edges(*parser.tree);
+        }
+        else if (edges(*parser.tree) != *reference)
+        {
+            std::cout << "  " << variant.name << " differs from the forest\n";
+            mismatches++;
+        }
+    }
+
+    return mismatches;
+}
+
+int main()
+{
+    const std::vector<Case> cases{
+        {"arithmetic", R"==(
+            Sum     -> Sum [+-] Product | Product
+            Product -> Product [*/] Factor | Factor
+            Factor  -> "(" Sum ")" | Number
+            Number  -> [0-9] Number | [0-9]
+        )==", {}},
+        {"ambiguous", R"==(
+            E -> E "+" E | E "*" E | "(" E ")" | [0-9]
+        )==", {}},
+        {"catalan", R"==(
+            S -> S S | "a"
+        )==", {}},
+        {"nullables", R"==(
+            S -> A "s" S B | "x" | A "y" B C
+            A -> "a" A | "a"
+            B -> "b" | C C
+            C -> "c"
+        )==", {"A", "B", "C"}},
+        {"right recursion", R"==(
+            L -> "a" L | "a" | "b" R
+            R -> "b" R | M
+            M -> "m" | "a" L
+        )==", {"M"}},
+        {"json", R"==(
+            Element  -> Ws Value Ws
+            Value    -> Object | Array | String | Number | "true" | "false" | "null"
+            Object   -> "{" Ws "}" | "{" Members "}"
+            Members  -> Member | Member "," Members
+            Member   -> Ws String Ws ":" Element
+            Array    -> "[" Ws "]" | "[" Elements "]"
+            Elements -> Element | Element "," Elements
+            String   -> "'" Chars "'" | "'" "'"
+            Chars    -> [a-z] Chars | [a-z]
+            Number   -> Digits | "-" Digits | Digits "." Digits
+            Digits   -> [0-9] Digits | [0-9]
+            Ws       -> [ ] Ws
+        )==", {"Ws"}},
+    };
+
+    std::mt19937 random{42};
+
+    std::size_t mismatches = 0;
+    for (const auto& test : cases)
+    {
+        mismatches += check(test, 1000, random);
+    }
+
+    // A long list each way and a deep nesting, a million levels are far more than a recursive walk's stack would take
+    const std::size_t depth = 1'000'000;
+    std::string list(depth * 2 - 1, ',');
+    for (std::size_t x = 0; x < list.size(); x += 2)
+    {
+        list[x] = 'a';
+    }
+
+    mismatches += checkDeep("left list", R"==(List -> List "," "a" | "a")==", list, false);
+    mismatches += checkDeep("right list", R"==(List -> "a" "," List | "a")==", list, true);
+    mismatches += checkDeep("nesting", R"==(Value -> "[" Value "]" | "a")==", std::string(depth, '[') + "a" + std::string(depth, ']'), false);
+
+    std::cout << (mismatches == 0 ? "all variants agree" : "the variants disagree") << "\n";
+    return mismatches == 0 ? 0 : 1;
+}
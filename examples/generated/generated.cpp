@@ -0,0 +1,62 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include "arithmetic.hpp"
+
+using namespace larley;
+
+// Actions are set by rule id, the order of the rules in grammar.txt
+auto makeParser()
+{
+    auto parser = arithmetic::makeParser();
+
+    const auto binary = [](auto& vals) -> float
+    {
+        const auto left = vals[0].as<float>();
+        const auto right = vals[2].as<float>();
+        switch (vals[1].src[0])
+        {
+            case '+': return left + right;
+            case '-': return left - right;
+            case '*': return left * right;
+            default: return left / right;
+        }
+    };
+
+    auto& semantics = parser.semantics;
+    semantics.setAction(0, binary);
+    semantics.setAction(2, binary);
+    semantics.setAction(4, [](auto& vals) { return vals[1]; });
+    semantics.setAction(5, [](auto& vals) { return std::stof(vals[0].as<std::string>()); });
+    semantics.setAction(6, [](auto& vals) { return std::string{vals[0].src} + vals[1].as<std::string>(); });
+    semantics.setAction(7, [](auto& vals) { return std::string{vals[0].src}; });
+
+    return parser;
+}
+
+int main()
+{
+    auto parser = makeParser();
+
+    std::string input = "1+2*(30-4)/5";
+    for (int x = 0; x < 2000; x++)
+    {
+        input += "+(1+2*3)/4";
+    }
+
+    const auto parse = [&](const char* name)
+    {
+        const auto start = std::chrono::high_resolution_clock::now();
+        const auto value = parser.parse(input);
+        const auto end = std::chrono::high_resolution_clock::now();
+
+        std::cout << name << ": " << value.as<float>() << " in " << std::chrono::duration<double, std::milli>(end - start).count() << "ms" << std::endl;
+    };
+
+    parse("generated");
+
+    // Same grammar and semantics through the generic recognizer
+    parser.recognizer = nullptr;
+    parse("generic");
+}
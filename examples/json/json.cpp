@@ -227,6 +227,8 @@ void parseJson()
 }
 )";
 
+	// Strings and numbers are each matched as a single regex terminal, their actions get their subtrees parsed back
+	gb.lexicalize = true;
 	auto parser = gb.makeParser();
 
     if (auto result = parser.parse(str); result.has_value())
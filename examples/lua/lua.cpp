@@ -19,7 +19,6 @@ void parseLua()
 {
     enum NonTerminals
     {
-        Ws,
         Chunk,
         Block,
         Stat,
@@ -66,16 +65,13 @@ void parseLua()
 
  // clang-format off
 
-	GB gb{Chunk, Ws};
-
-    gb(Ws);
-    gb(Ws) >> Regex{"\\s+"};
-    gb(Ws) >> Regex{"(\\s*--.*\\n\\s*)+"};
+	GB gb{Chunk};
+    gb.skipPattern = "(\\s|--.*\\n)*";
 
     gb(Name) >> Regex{"[a-zA-Z_][a-zA-Z_0-9]*"};
 
-    gb(LiteralString) >> "\"" & Regex("[^\"]*") & "\"";
-    gb(LiteralString) >> "'" & Regex("[^']*") & "'";
+    gb(LiteralString) >> Regex("\"[^\"]*\"");
+    gb(LiteralString) >> Regex("'[^']*'");
 
     gb(Numeral) >> Regex{"[0-9]+(.[0-9]+)?"};
 
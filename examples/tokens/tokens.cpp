@@ -33,6 +33,23 @@ struct Token
     std::string value;
 };
 
+// Token types double as the lookahead, predictions that can't start with the next token are skipped
+template <>
+struct larley::TerminalLookahead<Token::Type>
+{
+    static constexpr std::size_t size = static_cast<std::size_t>(Token::Type::Number) + 1;
+
+    static std::bitset<size> first(Token::Type type)
+    {
+        return std::bitset<size>{}.set(static_cast<std::size_t>(type));
+    }
+
+    static std::size_t at(std::span<Token> src, std::size_t index)
+    {
+        return static_cast<std::size_t>(src[index].type);
+    }
+};
+
 auto makeParser()
 {
     enum NonTerminals
@@ -46,7 +63,18 @@ auto makeParser()
         Whitespace
     };
 
-	using PT = ParserTypes<NonTerminals, Token::Type, std::span<Token>>;
+    // The parser types take the lambda's own type, the recognizer calls it directly and it inlines to a comparison
+    const auto matcher = [](auto src, std::size_t index, auto& type) -> int 
+    {
+        if (index >= src.size())
+        {
+            return -1;
+        }
+
+        return src[index].type == type ? 1 : -1;
+    };
+
+	using PT = ParserTypes<NonTerminals, Token::Type, std::span<Token>, void, std::uint32_t, std::remove_const_t<decltype(matcher)>>;
 	using GB = StringGrammarBuilder<PT>;
 
 	using Src = PT::Src;
@@ -73,16 +101,6 @@ auto makeParser()
 	
 // clang-format on
 
-    const auto matcher = [](auto src, std::size_t index, auto& type) -> int 
-    {
-        if (index >= src.size())
-        {
-            return -1;
-        }
-
-        return src[index].type == type ? 1 : -1;
-    };
-
     return Parser<PT>{
         Grammar<PT>{gb.startSymbol, gb.rules},
         matcher,
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include "parsing-tree.hpp"
+
+namespace larley
+{
+
+// A parse tree in three arrays indexed by node, the nodes in the same preorder as ParseTree
+// A node's subtree is the node and the `sizes[node] - 1` nodes after it, so a subtree is skipped without walking it
+struct CompactTree
+{
+    // Rule id of a terminal's node, the others have the id of their rule in the grammar
+    static constexpr std::uint32_t terminal = std::numeric_limits<std::uint32_t>::max();
+
+    struct Span
+    {
+        std::uint32_t start;
+        std::uint32_t end;
+    };
+
+    std::vector<std::uint32_t> rules;
+    std::vector<Span> spans;
+    std::vector<std::uint32_t> sizes;
+
+    std::uint32_t size() const
+    {
+        return static_cast<std::uint32_t>(rules.size());
+    }
+
+    bool isTerminal(std::uint32_t node) const
+    {
+        return rules[node] == terminal;
+    }
+
+    // The node after the subtree of `node`
+    std::uint32_t skip(std::uint32_t node) const
+    {
+        return node + sizes[node];
+    }
+
+    // A node along with where the subtree of its parent ends, its next siblings are the subtrees up to there
+    struct Cursor
+    {
+        const CompactTree* tree;
+        std::uint32_t node;
+        std::uint32_t parentEnd;
+
+        std::uint32_t rule() const
+        {
+            return tree->rules[node];
+        }
+
+        Span span() const
+        {
+            return tree->spans[node];
+        }
+
+        bool hasChildren() const
+        {
+            return tree->sizes[node] > 1;
+        }
+
+        // Only for a node with children, the node after a leaf isn't its child
+        Cursor firstChild() const
+        {
+            assert(hasChildren() && "node has no children");
+            return {tree, node + 1, tree->skip(node)};
+        }
+
+        bool hasNextSibling() const
+        {
+            return tree->skip(node) < parentEnd;
+        }
+
+        Cursor nextSibling() const
+        {
+            return {tree, tree->skip(node), parentEnd};
+        }
+    };
+
+    Cursor root() const
+    {
+        return {this, 0, size()};
+    }
+};
+
+// Positions and node counts must fit in 32 bits, the root's end being the largest position
+template <typename ParserTypes>
+CompactTree compactTree(const ParseTree<ParserTypes>& tree)
+{
+    if (tree.size() >= CompactTree::terminal || (!tree.empty() && tree[0].end > std::numeric_limits<std::uint32_t>::max()))
+    {
+        throw std::length_error("tree too large for CompactTree's 32-bit nodes and positions");
+    }
+
+    CompactTree compact;
+    compact.rules.reserve(tree.size());
+    compact.spans.reserve(tree.size());
+    compact.sizes.reserve(tree.size());
+
+    // The nodes whose subtree isn't over yet, with how many of their children haven't started
+    struct Open
+    {
+        std::uint32_t node;
+        std::size_t remaining;
+    };
+
+    std::vector<Open> open;
+    for (std::uint32_t node = 0; node < tree.size(); node++)
+    {
+        const auto& edge = tree[node];
+
+        compact.rules.push_back(edge.rule ? static_cast<std::uint32_t>(edge.rule->id) : CompactTree::terminal);
+        compact.spans.push_back({static_cast<std::uint32_t>(edge.start), static_cast<std::uint32_t>(edge.end)});
+        compact.sizes.push_back(1);
+
+        if (!open.empty())
+        {
+            open.back().remaining--;
+        }
+
+        if (edge.rule && !edge.rule->symbols.empty())
+        {
+            open.push_back({node, edge.rule->symbols.size()});
+            continue;
+        }
+
+        // A node without children ends the subtrees it's the last node of
+        while (!open.empty() && open.back().remaining == 0)
+        {
+            compact.sizes[open.back().node] = node + 1 - open.back().node;
+            open.pop_back();
+        }
+    }
+
+    return compact;
+}
+
+} // namespace larley
@@ -0,0 +1,252 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace larley
+{
+
+// Set of words compiled into a minimal acyclic automaton (DAFSA), words sharing a prefix or a suffix share their states
+// Built once from the words and read-only afterward, matching at a position costs a transition per byte whatever the word count
+class DictionaryAutomaton
+{
+  public:
+    explicit DictionaryAutomaton(std::vector<std::string> words)
+    {
+        // By unsigned bytes, the order the transitions are looked up in
+        std::ranges::sort(words, [](const std::string& first, const std::string& second)
+        {
+            return std::ranges::lexicographical_compare(first, second, [](char a, char b) { return static_cast<unsigned char>(a) < static_cast<unsigned char>(b); });
+        });
+        words.erase(std::ranges::unique(words).begin(), words.end());
+        wordCount = words.size();
+
+        Builder builder;
+        for (const auto& word : words)
+        {
+            builder.add(word);
+        }
+
+        freeze(builder.finish());
+    }
+
+    // Number of distinct words
+    std::size_t size() const
+    {
+        return wordCount;
+    }
+
+    std::size_t stateCount() const
+    {
+        return finals.size();
+    }
+
+    // Calls `onMatch(length)` for each word starting at `index`, by increasing length
+    void matches(std::string_view src, std::size_t index, const auto& onMatch) const
+    {
+        auto state = root;
+        for (auto position = index;; position++)
+        {
+            if (finals[state])
+            {
+                onMatch(position - index);
+            }
+
+            if (position >= src.size())
+            {
+                return;
+            }
+
+            state = next(state, static_cast<unsigned char>(src[position]));
+            if (state == none)
+            {
+                return;
+            }
+        }
+    }
+
+    // Length of the longest word starting at `index`, -1 if there is none
+    int longestMatch(std::string_view src, std::size_t index) const
+    {
+        int length = -1;
+        matches(src, index, [&](std::size_t matched) { length = static_cast<int>(matched); });
+        return length;
+    }
+
+    // Bytes the words can start with
+    std::bitset<256> firstBytes() const
+    {
+        std::bitset<256> bytes;
+        for (std::size_t byte = 0; byte < rootNext.size(); byte++)
+        {
+            bytes[byte] = rootNext[byte] != none;
+        }
+
+        return bytes;
+    }
+
+  private:
+    static constexpr std::uint32_t none = std::numeric_limits<std::uint32_t>::max();
+    static constexpr std::uint32_t root = 0;
+
+    // Daciuk et al.'s incremental construction from sorted words
+    // The states of the previous word past its common prefix with the new one can't change anymore, each is replaced by an
+    // equivalent state already registered or registered itself
+    class Builder
+    {
+      public:
+        struct State
+        {
+            bool final = false;
+
+            // Sorted by label since the words are, the last one is on the path of the previous word
+            std::vector<std::pair<unsigned char, std::uint32_t>> transitions;
+
+            bool operator==(const State& other) const = default;
+        };
+
+        void add(std::string_view word)
+        {
+            const auto common = static_cast<std::size_t>(std::ranges::mismatch(word, previous).in1 - word.begin());
+            minimize(common);
+
+            for (std::size_t x = common; x < word.size(); x++)
+            {
+                const auto state = static_cast<std::uint32_t>(states.size());
+                states.emplace_back();
+                states[path.back()].transitions.emplace_back(static_cast<unsigned char>(word[x]), state);
+                path.push_back(state);
+            }
+
+            states[path.back()].final = true;
+            previous = word;
+        }
+
+        // The states not reachable from the root anymore are left in, freeze skips them
+        std::vector<State> finish()
+        {
+            minimize(0);
+            return std::move(states);
+        }
+
+      private:
+        struct StateHash
+        {
+            std::size_t operator()(const State& state) const noexcept
+            {
+                std::size_t hash = state.final;
+                for (const auto& [label, target] : state.transitions)
+                {
+                    hash = (hash * 0x9E3779B97F4A7C15ull) ^ ((static_cast<std::size_t>(target) << 8) | label);
+                }
+
+                return hash;
+            }
+        };
+
+        std::vector<State> states{State{}};
+        std::unordered_map<State, std::uint32_t, StateHash> registry;
+
+        // States along the previous word, path[x] is reached after x bytes
+        std::vector<std::uint32_t> path{root};
+        std::string previous;
+
+        void minimize(std::size_t depth)
+        {
+            while (path.size() > depth + 1)
+            {
+                const auto state = path.back();
+                path.pop_back();
+
+                const auto [it, inserted] = registry.try_emplace(states[state], state);
+                if (!inserted)
+                {
+                    states[path.back()].transitions.back().second = it->second;
+                }
+            }
+        }
+    };
+
+    void freeze(const std::vector<Builder::State>& states)
+    {
+        // Renumbered in depth-first order from the root, which keeps it at 0
+        std::vector<std::uint32_t> ids(states.size(), none);
+        std::vector<std::uint32_t> order;
+        std::vector<std::uint32_t> stack{root};
+        while (!stack.empty())
+        {
+            const auto state = stack.back();
+            stack.pop_back();
+
+            if (ids[state] != none)
+            {
+                continue;
+            }
+
+            ids[state] = static_cast<std::uint32_t>(order.size());
+            order.push_back(state);
+
+            for (auto it = states[state].transitions.rbegin(); it != states[state].transitions.rend(); it++)
+            {
+                stack.push_back(it->second);
+            }
+        }
+
+        finals.reserve(order.size());
+        firstTransition.reserve(order.size() + 1);
+        for (const auto state : order)
+        {
+            finals.push_back(states[state].final);
+            firstTransition.push_back(static_cast<std::uint32_t>(labels.size()));
+
+            for (const auto& [label, target] : states[state].transitions)
+            {
+                labels.push_back(label);
+                targets.push_back(ids[target]);
+            }
+        }
+
+        firstTransition.push_back(static_cast<std::uint32_t>(labels.size()));
+
+        rootNext.fill(none);
+        for (auto transition = firstTransition[root]; transition < firstTransition[root + 1]; transition++)
+        {
+            rootNext[labels[transition]] = targets[transition];
+        }
+    }
+
+    std::uint32_t next(std::uint32_t state, unsigned char byte) const
+    {
+        if (state == root)
+        {
+            return rootNext[byte];
+        }
+
+        const auto begin = labels.begin() + firstTransition[state];
+        const auto end = labels.begin() + firstTransition[state + 1];
+
+        const auto it = std::lower_bound(begin, end, byte);
+        return it != end && *it == byte ? targets[it - labels.begin()] : none;
+    }
+
+    std::size_t wordCount{};
+
+    // The transitions of a state are [firstTransition[state], firstTransition[state + 1]), sorted by label
+    std::vector<std::uint32_t> firstTransition;
+    std::vector<unsigned char> labels;
+    std::vector<std::uint32_t> targets;
+    std::vector<bool> finals;
+
+    // The root usually has the most transitions, it gets a direct table
+    std::array<std::uint32_t, 256> rootNext;
+};
+
+} // namespace larley
@@ -1,6 +1,13 @@
 #pragma once
 
 #include <algorithm>
+#include <bitset>
+#include <limits>
+#include <map>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <unordered_map>
 #include <unordered_set>
 #include <variant>
 #include <vector>
@@ -57,6 +64,52 @@ struct Rule
     }
 };
 
+// Lookahead used by parseChart to skip the predictions that can't start with the next input symbol
+// Specialize it for a terminal type to map its terminals and the input positions to a small alphabet, see StringGrammar
+template <typename Terminal>
+struct TerminalLookahead
+{
+    // Number of lookahead symbols, 0 disables the lookahead
+    static constexpr std::size_t size = 0;
+
+    // Lookahead symbols the terminal can start with, it must never leave out one it can match
+    // When it's constexpr StaticGrammar computes the FIRST sets at compile time too
+    // static std::bitset<size> first(const Terminal& terminal);
+
+    // Lookahead symbol at a position of the input, never called at the end of the input
+    // static std::size_t at(Src src, std::size_t index);
+};
+
+// Aycock and Horspool's split LR(0) ε-DFA, its states stand for whole groups of dotted rules sharing an origin
+// See parseChartLR0
+template <typename ParserTypes>
+struct LR0Automaton
+{
+    static constexpr std::uint32_t noState = std::numeric_limits<std::uint32_t>::max();
+
+    struct State
+    {
+        // Sorted, includes the dotted rules reached by skipping over nullable symbols
+        std::vector<std::uint32_t> dottedRules;
+
+        // Products of the complete dotted rules, as non-terminal ids
+        std::vector<std::uint32_t> completed;
+
+        // Non-terminal id and the state reached once it's completed, sorted by id
+        std::vector<std::pair<std::uint32_t, std::uint32_t>> nonTerminalGotos;
+
+        // Dotted rule whose postdot terminal is scanned and the state reached once it's matched
+        // Terminals aren't required to be comparable, so each one gets its own transition
+        std::vector<std::pair<std::uint32_t, std::uint32_t>> terminalGotos;
+
+        // The ε successor, the non-kernel state of the predictions made from this state
+        std::uint32_t predicted = noState;
+    };
+
+    std::vector<State> states;
+    std::uint32_t startState;
+};
+
 template <typename ParserTypes>
 struct Grammar
 {
@@ -64,17 +117,464 @@ struct Grammar
     using LT = ParserTypes::Terminal;
     using RuleT = Rule<ParserTypes>;
 
+    static constexpr bool HasLookahead = TerminalLookahead<LT>::size > 0;
+    using Lookahead = std::bitset<TerminalLookahead<LT>::size>;
+
+    // LR(0) item, a rule with a dot somewhere in it
+    struct DottedRule
+    {
+        std::uint32_t rule;
+        std::uint32_t dot;
+    };
+
+    // Non-terminal a parse starts from and its prediction closure, the start symbol's unless it's given another one
+    struct Start
+    {
+        NT symbol;
+        std::uint32_t prediction;
+    };
+
     NT startSymbol;
     std::vector<RuleT> rules;
     std::unordered_set<NT> nullables;
 
+    // Numbered densely, rule after rule, so that the dotted rule after an incomplete one is the same rule with the dot advanced
+    std::vector<DottedRule> dottedRules;
+    std::vector<std::uint32_t> ruleToDottedRule;
+
+    static constexpr std::uint32_t noPrediction = std::numeric_limits<std::uint32_t>::max();
+
+    // Nullable aware prediction closure of each non-terminal, the dotted rules predicting it adds to a set
+    // Its rules, the rules those predict in turn, and the items reached by skipping over nullable symbols
+    std::vector<std::vector<std::uint32_t>> predictions;
+    // Closure of the postdot non-terminal, noPrediction if the postdot symbol isn't a non-terminal
+    std::vector<std::uint32_t> dottedRuleToPrediction;
+    std::uint32_t startPrediction;
+
+    static constexpr std::uint32_t noTerminal = std::numeric_limits<std::uint32_t>::max();
+
+    // Dense id of the postdot terminal of each dotted rule, noTerminal if it's not a terminal
+    // Equal terminals share an id when terminals can be compared, otherwise each occurrence gets its own
+    std::vector<std::uint32_t> terminalIds;
+    std::uint32_t terminalCount{};
+
+    static constexpr std::uint32_t noProduct = std::numeric_limits<std::uint32_t>::max();
+
+    // Dense id of the non-terminals, of each rule's product and of each dotted rule's postdot symbol, noProduct if it's not a non-terminal
+    // They label the symbol nodes of the parse forest, see ParseForest
+    std::vector<std::uint32_t> productIds;
+    std::vector<std::uint32_t> postdotProductIds;
+    std::uint32_t productCount{};
+
+    // FIRST set of what follows the dot of each dotted rule and whether it's nullable, only made if HasLookahead
+    std::vector<Lookahead> firstSets;
+    std::vector<bool> nullableSuffixes;
+
+    // The non-terminal a terminal stands for and a grammar with its rules, parseTree parses the terminal's span again from
+    // that non-terminal to get the subtree back. The expansions of a grammar usually share the same one
+    struct Expansion
+    {
+        std::shared_ptr<const Grammar> grammar;
+        Start start;
+    };
+
+    // Set by whoever replaced non-terminals with terminals matching the same strings, by dotted rule, see StringGrammar::lexicalize
+    // Empty or nullopt where nothing needs to be expanded
+    std::vector<std::optional<Expansion>> expansions;
+
     Grammar(NT startSymbol, std::vector<RuleT> rules) : startSymbol{startSymbol}, rules{std::move(rules)}, nullables{makeNullableSet()}
     {
         for (std::size_t x = 0; x < this->rules.size(); x++)
         {
             this->rules[x].id = x;
         }
+        makeDottedRules();
         check();
+        makePredictions();
+        makeFirstSets();
+        makeTerminalIds();
+        makeProductIds();
+    }
+
+    // Tables made beforehand, see StaticGrammar, they're the ones the other constructor would make
+    struct Tables
+    {
+        std::unordered_set<NT> nullables;
+        std::vector<DottedRule> dottedRules;
+        std::vector<std::uint32_t> ruleToDottedRule;
+        std::vector<std::vector<std::uint32_t>> predictions;
+        std::vector<std::uint32_t> dottedRuleToPrediction;
+        std::uint32_t startPrediction{};
+        std::vector<std::uint32_t> terminalIds;
+        std::uint32_t terminalCount{};
+
+        // Made at construction when left empty
+        std::vector<Lookahead> firstSets;
+        std::vector<bool> nullableSuffixes;
+    };
+
+    // The rules' ids must be their indexes, only the product ids are left to make, and the FIRST sets if they aren't given
+    Grammar(NT startSymbol, std::vector<RuleT> rules, Tables tables)
+        : startSymbol{startSymbol}, rules{std::move(rules)}, nullables{std::move(tables.nullables)}, dottedRules{std::move(tables.dottedRules)},
+          ruleToDottedRule{std::move(tables.ruleToDottedRule)}, predictions{std::move(tables.predictions)},
+          dottedRuleToPrediction{std::move(tables.dottedRuleToPrediction)}, startPrediction{tables.startPrediction},
+          terminalIds{std::move(tables.terminalIds)}, terminalCount{tables.terminalCount}, firstSets{std::move(tables.firstSets)},
+          nullableSuffixes{std::move(tables.nullableSuffixes)}
+    {
+        if (firstSets.empty())
+        {
+            makeFirstSets();
+        }
+        makeProductIds();
+    }
+
+    void makeDottedRules()
+    {
+        for (const auto& rule : rules)
+        {
+            if (dottedRules.size() + rule.symbols.size() + 1 > std::numeric_limits<std::uint32_t>::max())
+            {
+                throw std::length_error("invalid grammar, too many dotted rules");
+            }
+
+            ruleToDottedRule.push_back(static_cast<std::uint32_t>(dottedRules.size()));
+            for (std::size_t dot = 0; dot <= rule.symbols.size(); dot++)
+            {
+                dottedRules.push_back({static_cast<std::uint32_t>(rule.id), static_cast<std::uint32_t>(dot)});
+            }
+        }
+    }
+
+    void makePredictions()
+    {
+        std::unordered_map<NT, std::vector<const RuleT*>> productToRules;
+        for (const auto& rule : rules)
+        {
+            productToRules[rule.product].push_back(&rule);
+        }
+
+        std::unordered_map<NT, std::uint32_t> closureIds;
+        const auto getClosure = [&](const NT& symbol) -> std::uint32_t
+        {
+            if (const auto it = closureIds.find(symbol); it != closureIds.end())
+            {
+                return it->second;
+            }
+
+            std::vector<std::uint32_t> closure;
+            std::vector<NT> predicted{symbol};
+            std::unordered_set<NT> seen{symbol};
+            for (std::size_t x = 0; x < predicted.size(); x++)
+            {
+                const auto it = productToRules.find(predicted[x]);
+                if (it == productToRules.end())
+                {
+                    continue;
+                }
+
+                for (const auto* rule : it->second)
+                {
+                    const auto first = ruleToDottedRule[rule->id];
+                    closure.push_back(first);
+
+                    for (std::size_t dot = 0; dot < rule->symbols.size(); dot++)
+                    {
+                        const auto* nt = std::get_if<0>(&rule->symbols[dot]);
+                        if (!nt)
+                        {
+                            break;
+                        }
+
+                        if (seen.insert(*nt).second)
+                        {
+                            predicted.push_back(*nt);
+                        }
+
+                        if (!nullables.contains(*nt))
+                        {
+                            break;
+                        }
+
+                        closure.push_back(first + static_cast<std::uint32_t>(dot) + 1);
+                    }
+                }
+            }
+
+            const auto id = static_cast<std::uint32_t>(predictions.size());
+            predictions.push_back(std::move(closure));
+            closureIds.emplace(symbol, id);
+            return id;
+        };
+
+        dottedRuleToPrediction.reserve(dottedRules.size());
+        for (std::uint32_t x = 0; x < dottedRules.size(); x++)
+        {
+            const auto* nt = getPostdotNonTerminal(x);
+            dottedRuleToPrediction.push_back(nt ? getClosure(*nt) : noPrediction);
+        }
+
+        startPrediction = getClosure(startSymbol);
+    }
+
+    // Only the LR(0) recognizer uses it, Parser makes it on its first parse with ParseEngine::LR0
+    LR0Automaton<ParserTypes> makeAutomaton() const
+    {
+        LR0Automaton<ParserTypes> automaton;
+        auto& states = automaton.states;
+
+        std::unordered_map<NT, std::uint32_t> nonTerminalIds;
+        const auto getNonTerminalId = [&](const NT& symbol)
+        {
+            return nonTerminalIds.try_emplace(symbol, static_cast<std::uint32_t>(nonTerminalIds.size())).first->second;
+        };
+
+        std::map<std::vector<std::uint32_t>, std::uint32_t> stateIds;
+        const auto getState = [&](std::vector<std::uint32_t> dottedRules) -> std::uint32_t
+        {
+            std::ranges::sort(dottedRules);
+            dottedRules.erase(std::ranges::unique(dottedRules).begin(), dottedRules.end());
+
+            if (const auto it = stateIds.find(dottedRules); it != stateIds.end())
+            {
+                return it->second;
+            }
+
+            const auto id = static_cast<std::uint32_t>(states.size());
+            stateIds.emplace(dottedRules, id);
+            states.emplace_back().dottedRules = std::move(dottedRules);
+            return id;
+        };
+
+        // Skipping over a nullable symbol keeps the origin, the dotted rules reached that way belong to the same state
+        const auto getKernelState = [&](std::vector<std::uint32_t> dottedRules)
+        {
+            for (std::size_t x = 0; x < dottedRules.size(); x++)
+            {
+                const auto* nt = getPostdotNonTerminal(dottedRules[x]);
+                if (nt && nullables.contains(*nt))
+                {
+                    dottedRules.push_back(dottedRules[x] + 1);
+                }
+            }
+
+            return getState(std::move(dottedRules));
+        };
+
+        automaton.startState = getState(predictions[startPrediction]);
+
+        for (std::uint32_t stateIndex = 0; stateIndex < states.size(); stateIndex++)
+        {
+            // Copied, `states` grows while the transitions are made
+            const auto dottedRules = states[stateIndex].dottedRules;
+
+            std::vector<std::uint32_t> completed;
+            std::vector<std::pair<std::uint32_t, std::vector<std::uint32_t>>> nonTerminalKernels;
+            std::vector<std::pair<std::uint32_t, std::uint32_t>> terminalGotos;
+            std::vector<std::uint32_t> predicted;
+
+            for (const auto dottedRule : dottedRules)
+            {
+                const auto* symbol = getPostdotSymbol(dottedRule);
+                if (!symbol)
+                {
+                    completed.push_back(getNonTerminalId(getRule(dottedRule).product));
+                }
+                else if (const auto* nt = std::get_if<0>(symbol))
+                {
+                    const auto id = getNonTerminalId(*nt);
+                    auto it = std::ranges::find(nonTerminalKernels, id, &decltype(nonTerminalKernels)::value_type::first);
+                    if (it == nonTerminalKernels.end())
+                    {
+                        it = nonTerminalKernels.emplace(nonTerminalKernels.end(), id, std::vector<std::uint32_t>{});
+                    }
+                    it->second.push_back(dottedRule + 1);
+
+                    const auto& prediction = predictions[dottedRuleToPrediction[dottedRule]];
+                    predicted.insert(predicted.end(), prediction.begin(), prediction.end());
+                }
+                else
+                {
+                    terminalGotos.emplace_back(dottedRule, getKernelState({dottedRule + 1}));
+                }
+            }
+
+            std::ranges::sort(completed);
+            completed.erase(std::ranges::unique(completed).begin(), completed.end());
+
+            std::vector<std::pair<std::uint32_t, std::uint32_t>> nonTerminalGotos;
+            for (auto& [id, kernel] : nonTerminalKernels)
+            {
+                nonTerminalGotos.emplace_back(id, getKernelState(std::move(kernel)));
+            }
+            std::ranges::sort(nonTerminalGotos);
+
+            // Non-kernel states already contain their own predictions
+            std::ranges::sort(predicted);
+            predicted.erase(std::ranges::unique(predicted).begin(), predicted.end());
+            const auto predictedState = std::ranges::includes(dottedRules, predicted) ? LR0Automaton<ParserTypes>::noState : getState(std::move(predicted));
+
+            auto& state = states[stateIndex];
+            state.completed = std::move(completed);
+            state.nonTerminalGotos = std::move(nonTerminalGotos);
+            state.terminalGotos = std::move(terminalGotos);
+            state.predicted = predictedState;
+        }
+
+        return automaton;
+    }
+
+    void makeFirstSets()
+    {
+        if constexpr (HasLookahead)
+        {
+            firstSets.resize(dottedRules.size());
+            nullableSuffixes.resize(dottedRules.size());
+
+            std::vector<Lookahead> terminalFirsts(dottedRules.size());
+            for (std::uint32_t x = 0; x < dottedRules.size(); x++)
+            {
+                if (const auto* symbol = getPostdotSymbol(x); symbol && symbol->index() == 1)
+                {
+                    terminalFirsts[x] = TerminalLookahead<LT>::first(std::get<1>(*symbol));
+                }
+            }
+
+            // Each rule is walked back from its end, until the FIRST sets of the non-terminals stop growing
+            std::unordered_map<NT, Lookahead> nonTerminalFirsts;
+            for (bool changed = true; changed;)
+            {
+                changed = false;
+
+                for (const auto& rule : rules)
+                {
+                    const auto first = ruleToDottedRule[rule.id];
+
+                    Lookahead suffix;
+                    bool nullable = true;
+
+                    firstSets[first + rule.symbols.size()] = suffix;
+                    nullableSuffixes[first + rule.symbols.size()] = nullable;
+
+                    for (auto dot = rule.symbols.size(); dot-- > 0;)
+                    {
+                        if (const auto* nt = std::get_if<0>(&rule.symbols[dot]))
+                        {
+                            const auto& symbolFirst = nonTerminalFirsts[*nt];
+                            if (nullables.contains(*nt))
+                            {
+                                suffix |= symbolFirst;
+                            }
+                            else
+                            {
+                                suffix = symbolFirst;
+                                nullable = false;
+                            }
+                        }
+                        else
+                        {
+                            suffix = terminalFirsts[first + dot];
+                            nullable = false;
+                        }
+
+                        firstSets[first + dot] = suffix;
+                        nullableSuffixes[first + dot] = nullable;
+                    }
+
+                    auto& productFirst = nonTerminalFirsts[rule.product];
+                    if ((productFirst | suffix) != productFirst)
+                    {
+                        productFirst |= suffix;
+                        changed = true;
+                    }
+                }
+            }
+        }
+    }
+
+    void makeTerminalIds()
+    {
+        std::vector<const LT*> terminals;
+
+        terminalIds.reserve(dottedRules.size());
+        for (std::uint32_t x = 0; x < dottedRules.size(); x++)
+        {
+            const auto* symbol = getPostdotSymbol(x);
+            if (!symbol || symbol->index() != 1)
+            {
+                terminalIds.push_back(noTerminal);
+                continue;
+            }
+
+            const auto& terminal = std::get<1>(*symbol);
+
+            auto it = terminals.end();
+            if constexpr (isEqualityComparable<LT>)
+            {
+                it = std::ranges::find_if(terminals, [&](const auto* other) { return *other == terminal; });
+            }
+
+            if (it == terminals.end())
+            {
+                it = terminals.insert(terminals.end(), &terminal);
+            }
+
+            terminalIds.push_back(static_cast<std::uint32_t>(it - terminals.begin()));
+        }
+
+        terminalCount = static_cast<std::uint32_t>(terminals.size());
+    }
+
+    void makeProductIds()
+    {
+        std::unordered_map<NT, std::uint32_t> ids;
+        const auto getId = [&](const NT& symbol)
+        {
+            return ids.try_emplace(symbol, static_cast<std::uint32_t>(ids.size())).first->second;
+        };
+
+        productIds.reserve(rules.size());
+        for (const auto& rule : rules)
+        {
+            productIds.push_back(getId(rule.product));
+        }
+
+        postdotProductIds.reserve(dottedRules.size());
+        for (std::uint32_t x = 0; x < dottedRules.size(); x++)
+        {
+            const auto* nt = getPostdotNonTerminal(x);
+            postdotProductIds.push_back(nt ? getId(*nt) : noProduct);
+        }
+
+        productCount = static_cast<std::uint32_t>(ids.size());
+    }
+
+    const RuleT& getRule(std::uint32_t dottedRule) const
+    {
+        return rules[dottedRules[dottedRule].rule];
+    }
+
+    std::size_t getDot(std::uint32_t dottedRule) const
+    {
+        return dottedRules[dottedRule].dot;
+    }
+
+    bool isComplete(std::uint32_t dottedRule) const
+    {
+        return getDot(dottedRule) >= getRule(dottedRule).symbols.size();
+    }
+
+    // The symbol right after the dot, null if the dotted rule is complete
+    const typename RuleT::Symbol* getPostdotSymbol(std::uint32_t dottedRule) const
+    {
+        const auto& [rule, dot] = dottedRules[dottedRule];
+        const auto& symbols = rules[rule].symbols;
+        return dot < symbols.size() ? &symbols[dot] : nullptr;
+    }
+
+    const NT* getPostdotNonTerminal(std::uint32_t dottedRule) const
+    {
+        const auto* symbol = getPostdotSymbol(dottedRule);
+        return symbol ? std::get_if<0>(symbol) : nullptr;
     }
 
     bool isNullable(const RuleT& rule) const
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "parser.hpp"
+#include "string-grammar.hpp"
+
+// Text format for string grammars, one or more alternatives per non-terminal:
+//
+//   Sum    -> Sum [+-] Product | Product
+//   Factor -> "(" Sum ")" | [0-9]
+//
+// [a-b] is a range, [abc] a choice of single characters, "..." a literal and any other name a non-terminal
+namespace larley::MetaGrammar
+{
+
+// Non-terminals are the names used in the text
+using GenNT = std::string;
+
+using GenPT = ParserTypes<GenNT, StringGrammar::TerminalSymbol, std::string_view>;
+using GenRule = larley::Rule<GenPT>;
+using GenSymbol = GenRule::Symbol;
+
+// Parser of the text format, its value is the rules in the order they're written
+inline auto makeParser()
+{
+    enum NonTerminals
+    {
+        Ws,
+        Identifier,
+        Range,
+        Choice,
+        Literal,
+        Rules,
+        Rule,
+        Symbols,
+        Symbol,
+        Definitions,
+        Grammar
+    };
+
+    using PT = ParserTypes<NonTerminals, StringGrammar::TerminalSymbol, std::string_view>;
+    using GB = StringGrammarBuilder<PT>;
+
+    using Src = PT::Src;
+
+ // clang-format off
+
+    GB gb{Grammar, Ws};
+
+    gb(Ws);
+    gb(Ws) >> GB::Regex{"\\s+"};
+
+    gb(Identifier) >> GB::Regex{"[a-zA-Z_][a-zA-Z_0-9]*"} | [](auto& vals)
+    { 
+        return std::string{vals[0].src};
+    };
+
+    gb(Range) >> GB::Regex{"\\[.\\-.\\]"} | [](auto& vals) -> GenSymbol
+    { 
+        return typename StringGrammar::RangeTerminalSymbol{std::string{vals[0].src[1]}, std::string{vals[0].src[3]}};
+    };
+
+    // Any bracket but a range's "[x-y]", so that a bracket is never both
+    gb(Choice) >> GB::Regex{"\\[([^\\]]|[^\\]][^\\]]|[^\\]][^\\]\\-][^\\]]|[^\\]][^\\]][^\\]][^\\]]+)\\]"} | [](auto& vals) -> GenSymbol
+    { 
+        StringGrammar::ChoiceTerminalSymbol choices;
+        const auto& src = vals[0].src;
+        for (const auto c : src.substr(1, src.size() - 2))
+        {
+            choices.push_back(std::string{c});
+        }
+
+        return choices;
+    };    
+
+    gb(Literal) >> GB::Regex("\\\"[^\"]*\\\"") | [](auto& vals) -> GenSymbol
+    { 
+        const auto& src = vals[0].src;
+        // A plain string would be taken for a non-terminal
+        return GenSymbol{std::in_place_index<1>, StringGrammar::LiteralTerminalSymbol{src.data() + 1, src.data() + src.size() - 1}};
+    };
+
+    gb(Rule) >> Identifier & "->" & Definitions | [](auto& vals)
+    { 
+        auto id = vals[0].as<GenNT>();
+        std::vector<GenRule> rules;
+        auto& definitions = vals[2].as<std::vector<std::vector<GenSymbol>>>();
+        for (auto& definition : definitions)
+        {
+            rules.emplace_back(id, std::move(definition));
+        }
+        return rules;
+    };
+
+    gb(Rules) >> Rule;
+    gb(Rules) >> Rules & Rule | [](auto& vals)
+    { 
+        auto& v1 = vals[0].as<std::vector<GenRule>>();
+        auto& v2 = vals[1].as<std::vector<GenRule>>();
+
+        v1.insert(v1.end(), v2.begin(), v2.end());
+
+        return std::move(v1);
+    };
+    
+    gb(Definitions) >> Symbols | [](auto& vals)
+    { 
+        std::vector<std::vector<GenSymbol>> v;
+        v.push_back(vals[0].as<std::vector<GenSymbol>>());
+        return std::move(v);
+    };
+    gb(Definitions) >> Definitions & "|" & Symbols | [](auto& vals)
+    { 
+        auto& v = vals[0].as<std::vector<std::vector<GenSymbol>>>();
+        v.push_back(vals[2].as<std::vector<GenSymbol>>());
+        return std::move(v);
+    };
+
+    gb(Symbols) >> Symbol | [](auto& vals)
+    { 
+        std::vector<GenSymbol> v;
+        v.push_back(vals[0].as<GenSymbol>());
+        return std::move(v);
+    };
+    gb(Symbols) >> Symbols & Symbol | [](auto& vals)
+    { 
+        auto& v = vals[0].as<std::vector<GenSymbol>>();
+        v.push_back(vals[1].as<GenSymbol>());
+        return std::move(v);
+    };
+
+    gb(Symbol) >> Range;
+    gb(Symbol) >> Choice;
+    gb(Symbol) >> Literal;
+    gb(Symbol) >> Identifier | [](auto& vals) -> GenSymbol { return vals[0].as<GenNT>(); };
+
+    gb(Grammar) >> Rules;
+    
+// clang-format on
+
+    return gb.makeParser();
+}
+
+// Rules of a grammar written in the text format, the product of the first one is the start symbol
+// The error is printed and nullopt returned if the text doesn't parse
+inline std::optional<std::vector<GenRule>> parseRules(std::string_view text)
+{
+    auto parser = makeParser();
+    if (auto value = parser.parse(text); value.has_value())
+    {
+        auto rules = std::move(value.as<std::vector<GenRule>>());
+        for (std::size_t x = 0; x < rules.size(); x++)
+        {
+            rules[x].id = x;
+        }
+
+        return rules;
+    }
+
+    parser.printError();
+    return {};
+}
+
+} // namespace larley::MetaGrammar
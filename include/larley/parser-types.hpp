@@ -1,9 +1,16 @@
 #pragma once
 
+#include <cstdint>
 #include <functional>
 #include <string_view>
+#include <type_traits>
 
-template <typename NonTerminalT, typename TerminalT, typename SrcT = std::string_view, typename CtxT = void>
+// Type-erased matcher, any matcher converts to it
+template <typename SrcT, typename TerminalT>
+using DefaultMatcher = std::function<int(SrcT, std::size_t, const TerminalT&)>;
+
+// MatcherT can be the matcher's own type, like a lambda or a function object, for the recognizer to call it directly
+template <typename NonTerminalT, typename TerminalT, typename SrcT = std::string_view, typename CtxT = void, typename OriginT = std::uint32_t, typename MatcherT = DefaultMatcher<SrcT, TerminalT>>
 struct ParserTypes
 {
     using Terminal = TerminalT;
@@ -12,8 +19,16 @@ struct ParserTypes
     using SrcElement = SrcT;
     using Src = SrcT;
 
-    using Matcher = std::function<int(Src, std::size_t, const Terminal&)>;
+    // Length of the terminal matched at a position, -1 if it doesn't match
+    using Matcher = MatcherT;
+    static_assert(std::is_invocable_r_v<int, const Matcher&, Src, std::size_t, const Terminal&>, "the matcher must be callable as int(Src, std::size_t, const Terminal&)");
+
+    // Optional, length of the input to skip at a position before matching terminals there, like whitespace and comments
+    using Skipper = std::function<std::size_t(Src, std::size_t)>;
 
     static constexpr bool HasContext = !std::is_same_v<void, CtxT>;
     using Ctx = CtxT;
+
+    // Type of the input positions stored in each Earley item, use std::uint64_t for inputs of 4GB or more
+    using Origin = OriginT;
 };
\ No newline at end of file
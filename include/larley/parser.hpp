@@ -1,10 +1,15 @@
 #pragma once
 
+#include <cassert>
+#include <functional>
+#include <memory>
 #include <optional>
 
+#include "compact-tree.hpp"
 #include "grammar.hpp"
 #include "parser-types.hpp"
 #include "parsing-chart.hpp"
+#include "parsing-chart-lr0.hpp"
 #include "parsing-error.hpp"
 #include "parsing-semantics.hpp"
 #include "parsing-tree.hpp"
@@ -14,6 +19,15 @@
 namespace larley
 {
 
+// Recognizer used to build the chart, both give the same chart and so the same tree
+enum class ParseEngine
+{
+    // Items are dotted rules, with Leo's transitive items for right recursion
+    Earley,
+    // Items are states of the grammar's LR(0) automaton, fewer and bigger items, see parseChartLR0
+    LR0,
+};
+
 template <typename ParserTypes>
 struct Parser
 {
@@ -24,6 +38,24 @@ struct Parser
     Grammar<ParserTypes> grammar;
     ParserTypes::Matcher matcher;
     Semantics<ParserTypes> semantics;
+    ParseEngine engine = ParseEngine::Earley;
+
+    // The grammar's LR(0) automaton, made by the first parse with ParseEngine::LR0 and shared by the copies made after it
+    std::shared_ptr<const LR0Automaton<ParserTypes>> automaton;
+
+    // What the Earley chart keeps of the derivations, the tree is the same in every mode, see ChartMode
+    // Only ChartMode::Forest builds the parse forest
+    ChartMode chartMode = ChartMode::Items;
+
+    // Optional, the chart skips what it returns before the terminals of each set, those skipped spans never get an item
+    // The leaves of the tree and the non-terminals starting with a terminal don't include them
+    ParserTypes::Skipper skipper;
+
+    using Recognizer = std::function<ParseChart<ParserTypes>(const Grammar<ParserTypes>&, const typename ParserTypes::Matcher&, Src, const typename ParserTypes::Skipper&, ChartMode)>;
+
+    // Optional, builds the chart instead of the engine, like the recognizer of a generated parser, see tools/larley-gen
+    // It must build the chart parseChart would, the tree and the semantics are the same either way
+    Recognizer recognizer;
 
     Ctx* ctx{};
     Src src;
@@ -36,7 +68,24 @@ struct Parser
 
     void parseChart()
     {
-        chart = ::parseChart(grammar, matcher, src);
+        if (recognizer)
+        {
+            chart = recognizer(grammar, matcher, src, skipper, chartMode);
+            return;
+        }
+
+        if (engine == ParseEngine::LR0)
+        {
+            if (!automaton)
+            {
+                automaton = std::make_shared<const LR0Automaton<ParserTypes>>(grammar.makeAutomaton());
+            }
+
+            chart = ::parseChartLR0(grammar, *automaton, matcher, src, skipper);
+            return;
+        }
+
+        chart = ::parseChart(grammar, matcher, src, skipper, chartMode);
     }
 
     void parseTree()
@@ -0,0 +1,230 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "grammar.hpp"
+#include "parsing-chart.hpp"
+
+namespace larley
+{
+
+// Earley item of the LR(0) recognizer, a state of the automaton stands for all its dotted rules at once
+template <typename ParserTypes>
+struct LR0Item
+{
+    using Origin = ParserTypes::Origin;
+
+    std::uint32_t state;
+    Origin start;
+
+    auto operator<=>(const LR0Item& other) const = default;
+
+    struct Hash
+    {
+        std::size_t operator()(const LR0Item& item) const noexcept
+        {
+            return typename Item<ParserTypes>::Hash{}({item.state, item.start});
+        }
+    };
+};
+
+template <typename ParserTypes>
+struct LR0StateSet : std::vector<LR0Item<ParserTypes>>
+{
+    using Origin = ParserTypes::Origin;
+
+    ItemTable<ParserTypes, LR0Item<ParserTypes>> added;
+
+    // Items whose state has a transition on a given non-terminal, chained through `waitingEntries`
+    // Each entry keeps the state the transition leads to, completing is then a plain walk of the chain
+    struct WaitingEntry
+    {
+        std::uint32_t state;
+        Origin start;
+        std::size_t next;
+    };
+
+    static constexpr std::size_t noEntry = static_cast<std::size_t>(-1);
+
+    std::vector<std::pair<std::uint32_t, std::size_t>> waiting;
+    std::vector<WaitingEntry> waitingEntries;
+
+    // Copied to the expanded set, see StateSet::matchesBegin
+    std::size_t matchesBegin{};
+    std::size_t matchesEnd{};
+
+    std::size_t findWaiting(std::uint32_t symbol) const
+    {
+        const auto it = std::ranges::find(waiting, symbol, &decltype(waiting)::value_type::first);
+        return it != waiting.end() ? it->second : noEntry;
+    }
+
+    void add(const LR0Automaton<ParserTypes>& automaton, LR0Item<ParserTypes> item)
+    {
+        for (const auto& [symbol, state] : automaton.states[item.state].nonTerminalGotos)
+        {
+            const auto entry = waitingEntries.size();
+            if (auto it = std::ranges::find(waiting, symbol, &decltype(waiting)::value_type::first); it != waiting.end())
+            {
+                waitingEntries.push_back({state, item.start, it->second});
+                it->second = entry;
+            }
+            else
+            {
+                waitingEntries.push_back({state, item.start, noEntry});
+                waiting.emplace_back(symbol, entry);
+            }
+        }
+
+        this->push_back(item);
+    }
+};
+
+// Aycock and Horspool's "Practical Earley Parsing", items are (state of the grammar's automaton, origin), see Grammar::makeAutomaton
+// Every alternative predicted or advanced together shares one item, so the sets and the completion work are much smaller
+// Completing nullable symbols is folded into the states, items that start at their own set are never completed
+// The recognized sets are then expanded back to dotted rules, the chart is the same as parseChart's and so is the tree
+// There are no Leo transitive items, right recursion stays quadratic with this recognizer
+// The chart only has the items, see ChartMode::Items
+template<typename ParserTypes>
+static ParseChart<ParserTypes> parseChartLR0(const Grammar<ParserTypes>& grammar, const LR0Automaton<ParserTypes>& automaton, const typename ParserTypes::Matcher& matcher, typename ParserTypes::Src src, const typename ParserTypes::Skipper& skipper = {})
+{
+    using ItemT = Item<ParserTypes>;
+    using LR0ItemT = LR0Item<ParserTypes>;
+    using Origin = ItemT::Origin;
+
+    if (src.size() >= std::numeric_limits<Origin>::max())
+    {
+        throw std::length_error("input too large for the parser's Origin type");
+    }
+
+    constexpr auto noState = LR0Automaton<ParserTypes>::noState;
+
+    StateSets<ParserTypes, LR0StateSet<ParserTypes>> S;
+
+    // An item comes with its ε successor, which starts at the set it's added to
+    const auto addItem = [&](auto& set, std::size_t setIndex, LR0ItemT item)
+    {
+        if (!set.added.insert(item))
+        {
+            return;
+        }
+
+        set.add(automaton, item);
+
+        if (const auto predicted = automaton.states[item.state].predicted; predicted != noState)
+        {
+            const LR0ItemT predictedItem{predicted, static_cast<Origin>(setIndex)};
+            if (set.added.insert(predictedItem))
+            {
+                set.add(automaton, predictedItem);
+            }
+        }
+    };
+
+    ParseChart<ParserTypes> result;
+    result.mode = ChartMode::Items;
+
+    const GrammarDispatch<ParserTypes> dispatch{grammar, matcher};
+    impl::Scanner<ParserTypes, LR0ItemT> scanner(grammar, dispatch, skipper, src, result);
+
+    const auto advance = [&](LR0ItemT item, std::size_t end)
+    {
+        addItem(S[end], end, item);
+    };
+
+    addItem(S[0], 0, {automaton.startState, 0});
+
+    for (std::size_t stateIndex = 0; stateIndex < S.size(); stateIndex++)
+    {
+        if (!S.contains(stateIndex))
+        {
+            continue;
+        }
+
+        auto& set = S[stateIndex];
+        set.matchesBegin = result.terminalMatches.size();
+        scanner.skip(stateIndex);
+
+        for (std::size_t itemIndex = 0; itemIndex < set.size(); itemIndex++)
+        {
+            const auto item = set[itemIndex];
+            const auto& state = automaton.states[item.state];
+
+            for (const auto& [dottedRule, next] : state.terminalGotos)
+            {
+                scanner.scan(stateIndex, dottedRule, {next, item.start}, advance);
+            }
+
+            if (item.start == stateIndex)
+            {
+                continue;
+            }
+
+            const auto& originSet = S[item.start];
+            for (const auto symbol : state.completed)
+            {
+                for (auto entry = originSet.findWaiting(symbol); entry != originSet.noEntry; entry = originSet.waitingEntries[entry].next)
+                {
+                    const auto& waitingEntry = originSet.waitingEntries[entry];
+                    addItem(set, stateIndex, {waitingEntry.state, waitingEntry.start});
+                }
+            }
+        }
+
+        set.added.clear();
+        impl::sortMatches(result, set);
+    }
+
+    // Items that start at their own set can come from several states, they're deduplicated by dotted rule like in parseChart
+    constexpr auto noPosition = std::numeric_limits<std::size_t>::max();
+    std::vector<std::size_t> addedAt(grammar.dottedRules.size(), noPosition);
+
+    for (std::size_t stateIndex = 0; stateIndex < S.size(); stateIndex++)
+    {
+        if (!S.contains(stateIndex))
+        {
+            continue;
+        }
+
+        auto& lr0Set = S[stateIndex];
+        auto& set = result.S[stateIndex];
+
+        set.matchesBegin = lr0Set.matchesBegin;
+        set.matchesEnd = lr0Set.matchesEnd;
+
+        for (const auto& lr0Item : lr0Set)
+        {
+            for (const auto dottedRule : automaton.states[lr0Item.state].dottedRules)
+            {
+                const ItemT item{dottedRule, lr0Item.start};
+                if (item.start == stateIndex)
+                {
+                    if (addedAt[dottedRule] == stateIndex)
+                    {
+                        continue;
+                    }
+
+                    addedAt[dottedRule] = stateIndex;
+                }
+                else if (!set.added.insert(item))
+                {
+                    continue;
+                }
+
+                // The waiting lists are only used while recognizing, they're left empty
+                set.push_back(item);
+            }
+        }
+
+        set.added.clear();
+    }
+
+    impl::countMatches(grammar, result, src);
+
+    return result;
+}
+
+} // namespace larley
@@ -1,192 +1,1257 @@
 #pragma once
 
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <optional>
+#include <unordered_map>
+
 #include "grammar.hpp"
+#include "parsing-forest.hpp"
 #include "utils.hpp"
 
 namespace larley
 {
 
+// Earley item packed as its dotted rule and origin, see Grammar::dottedRules
 template <typename ParserTypes>
 struct Item
 {
-    const Rule<ParserTypes>& rule;
-    std::size_t start;
-    std::size_t dot;
+    using Origin = ParserTypes::Origin;
+
+    std::uint32_t dottedRule;
+    Origin start;
 
-    bool operator==(const Item& other) const
+    auto operator<=>(const Item& other) const = default;
+
+    Item advanced() const
     {
-        return start == other.start && dot == other.dot && &rule == &other.rule;
+        return {dottedRule + 1, start};
     }
 
-    Item advanced() const
+    struct Hash
     {
-        return {rule, start, dot + 1};
+        std::size_t operator()(const Item& item) const noexcept
+        {
+            if constexpr (sizeof(Origin) <= sizeof(std::uint32_t))
+            {
+                return std::hash<std::uint64_t>{}((static_cast<std::uint64_t>(item.start) << 32) | item.dottedRule);
+            }
+            else
+            {
+                return std::hash<std::uint64_t>{}((static_cast<std::uint64_t>(item.start) * 0x9E3779B97F4A7C15ull) ^ item.dottedRule);
+            }
+        }
+    };
+};
+
+// Leo's transitive item, memoized per set and per awaited symbol
+// When the only item of a set waiting on a symbol is penultimate (B -> β•A) completing A just climbs a deterministic chain
+// so the topmost completed item is added directly instead of every item of the chain, which keeps right recursion linear
+template <typename ParserTypes>
+struct TransitiveItem
+{
+    // Topmost item of the chain, complete
+    Item<ParserTypes> top;
+
+    // The penultimate item itself, the next link of the chain is looked up in the set it starts at
+    Item<ParserTypes> penultimate;
+
+    // Its node in the parse forest
+    std::uint32_t penultimateNode;
+
+    // Its index in its set, and the top's own penultimate item, for the back-pointers of ChartMode::BackPointers
+    std::uint32_t penultimateIndex;
+    ParserTypes::Origin topSplit;
+    std::uint32_t topPredecessor;
+
+    // The complete dotted rule of the top's last child, the link below it, noChild when the top is the first link and its last
+    // child is the item completed into the chain
+    static constexpr std::uint32_t noChild = std::numeric_limits<std::uint32_t>::max();
+    std::uint32_t topChild;
+};
+
+// How an item was derived, one per item of a set with ChartMode::BackPointers
+// The item's predecessor is the item before its dot in the set at `split` and its last child spans from `split` to the set
+// An item starting at its own set has none, all the symbols before its dot derive the empty string there
+// Of the ways an item is derived parseChart keeps the one chartTree takes, the earliest rule then the longest span for each
+// child from the first one on
+template <typename ParserTypes>
+struct BackPointer
+{
+    using Origin = ParserTypes::Origin;
+
+    // Flags the complete item that went up a chain of Leo's transitive items to this one, the chain's links aren't in the
+    // chart, parseTree climbs the chain from it again
+    static constexpr std::uint32_t leoChain = 1u << 31;
+
+    // The child is a terminal
+    static constexpr std::uint32_t terminal = leoChain - 1;
+
+    // The child is a nullable non-terminal the predecessor was advanced past right away
+    static constexpr std::uint32_t empty = leoChain - 2;
+
+    Origin split;
+
+    // Index of the predecessor in its set
+    std::uint32_t predecessor;
+
+    // Index of the child in the item's set, a complete item, or one of the above
+    std::uint32_t child;
+};
+
+// Open addressing hash set of items with linear probing, used to deduplicate the items of a set while it's being built
+// A flat array of packed items, unlike std::unordered_set it doesn't allocate a node per item
+// ItemT is any pair of a 32 bits id and an origin with a Hash, the max id is reserved
+template <typename ParserTypes, typename ItemT = Item<ParserTypes>>
+class ItemTable
+{
+    // Never a valid dotted rule id, see Grammar::makeDottedRules
+    static constexpr ItemT emptySlot{std::numeric_limits<std::uint32_t>::max(), 0};
+    static constexpr std::size_t initialCapacity = 16;
+
+    std::vector<ItemT> slots;
+    std::size_t count{};
+    std::size_t shift{};
+
+    // Index of the item of each slot in its set, only kept by the tables filled by the insert that takes one
+    std::vector<std::uint32_t> indices;
+    bool indexed = false;
+
+    std::size_t slotIndex(const ItemT& item) const
+    {
+        // Fibonacci hashing, spreads the packed item over the high bits so items that only differ by origin don't cluster
+        return (static_cast<std::uint64_t>(typename ItemT::Hash{}(item)) * 0x9E3779B97F4A7C15ull) >> shift;
     }
 
-    bool isComplete() const
+    void grow()
     {
-        return dot >= rule.symbols.size();
+        auto oldSlots = std::move(slots);
+        auto oldIndices = std::move(indices);
+        const auto capacity = oldSlots.empty() ? initialCapacity : oldSlots.size() * 2;
+
+        slots.assign(capacity, emptySlot);
+        shift = 64 - std::countr_zero(capacity);
+        if (indexed)
+        {
+            indices.resize(capacity);
+        }
+
+        for (std::size_t x = 0; x < oldSlots.size(); x++)
+        {
+            const auto& item = oldSlots[x];
+            if (item != emptySlot)
+            {
+                auto index = slotIndex(item);
+                while (slots[index] != emptySlot)
+                {
+                    index = (index + 1) & (slots.size() - 1);
+                }
+                slots[index] = item;
+
+                if (indexed)
+                {
+                    indices[index] = oldIndices[x];
+                }
+            }
+        }
     }
 
-    bool isAtSymbol(ParserTypes::NonTerminal symbol) const
+    // The slot of the item, it's added to it if it wasn't in the table yet
+    std::pair<std::size_t, bool> probe(const ItemT& item)
     {
-        if (isComplete())
+        // Keeps the load factor under 1/2, probe sequences stay short
+        if ((count + 1) * 2 > slots.size())
         {
-            return false;
+            grow();
+        }
+
+        auto index = slotIndex(item);
+        while (slots[index] != emptySlot)
+        {
+            if (slots[index] == item)
+            {
+                return {index, false};
+            }
+
+            index = (index + 1) & (slots.size() - 1);
         }
 
-        const auto& ruleSymbol = rule.symbols[dot];
-        return ruleSymbol.index() == 0 && std::get<0>(ruleSymbol) == symbol;
+        slots[index] = item;
+        count++;
+        return {index, true};
     }
 
-    struct Hash
+  public:
+    // Returns true if the item wasn't in the table yet
+    bool insert(const ItemT& item)
     {
-        std::size_t operator()(const Item& item) const noexcept
+        return probe(item).second;
+    }
+
+    // Keeps `index` with the item if it wasn't in the table yet, returns the index kept with it
+    // A table only takes either this insert or the other one
+    std::uint32_t insert(const ItemT& item, std::uint32_t index)
+    {
+        if (!indexed)
         {
-            return std::hash<std::size_t>{}((item.start << 32) | (item.rule.id << 16) | (item.dot << 0));
+            assert(count == 0 && "the table's items were inserted without an index");
+            indexed = true;
+            indices.resize(slots.size());
         }
-    };
+
+        const auto [slot, inserted] = probe(item);
+        if (inserted)
+        {
+            indices[slot] = index;
+        }
+
+        return indices[slot];
+    }
+
+    // Releases the memory, a set can't receive new items once it's been processed
+    void clear()
+    {
+        slots = {};
+        indices = {};
+        count = 0;
+    }
 };
 
 template <typename ParserTypes>
 struct StateSet : std::vector<Item<ParserTypes>>
 {
-    std::unordered_set<Item<ParserTypes>, typename Item<ParserTypes>::Hash> added;
+    ItemTable<ParserTypes> added;
+    // Empty when the symbol has no transitive item in this set
+    std::unordered_map<typename ParserTypes::NonTerminal, std::optional<TransitiveItem<ParserTypes>>> transitives;
+
+    // Items whose dot is before a given non-terminal, chained in insertion order through `nextWaiting`
+    // The completer only visits those instead of the whole set
+    struct WaitingList
+    {
+        std::size_t first;
+        std::size_t last;
+        std::size_t count;
+    };
+
+    static constexpr std::size_t noItem = static_cast<std::size_t>(-1);
+
+    // A set only waits on a handful of non-terminals, a flat list beats hashing here
+    std::vector<std::pair<typename ParserTypes::NonTerminal, WaitingList>> waiting;
+    std::vector<std::size_t> nextWaiting;
+
+    // Node of each item in the parse forest, see ParseForest
+    std::vector<std::uint32_t> nodes;
+
+    // Back-pointer of each item, see BackPointer
+    std::vector<BackPointer<ParserTypes>> backPointers;
+
+    // Range of the terminals tried at this position in ParseChart::terminalMatches
+    std::size_t matchesBegin{};
+    std::size_t matchesEnd{};
+
+    // Input skipped before the terminals of this position, see Parser::skipper
+    std::size_t skipped{};
+
+    const WaitingList* findWaiting(const typename ParserTypes::NonTerminal& symbol) const
+    {
+        const auto it = std::ranges::find(waiting, symbol, &decltype(waiting)::value_type::first);
+        return it != waiting.end() ? &it->second : nullptr;
+    }
+
+    void add(const Grammar<ParserTypes>& grammar, Item<ParserTypes> item, std::uint32_t node)
+    {
+        const auto index = this->size();
+        nextWaiting.push_back(noItem);
+        nodes.push_back(node);
+
+        if (const auto* nt = grammar.getPostdotNonTerminal(item.dottedRule))
+        {
+            if (auto it = std::ranges::find(waiting, *nt, &decltype(waiting)::value_type::first); it != waiting.end())
+            {
+                auto& list = it->second;
+                nextWaiting[list.last] = index;
+                list.last = index;
+                list.count++;
+            }
+            else
+            {
+                waiting.emplace_back(*nt, WaitingList{index, index, 1});
+            }
+        }
+
+        this->push_back(item);
+    }
+};
+
+// Sparse store of the state sets, indexed by input position
+// Sets are only created once an item reaches their position, a position skipped by a terminal only costs an index entry
+// and nothing is allocated past the last position the parse reached
+template <typename ParserTypes, typename StateSetT = StateSet<ParserTypes>>
+class StateSets
+{
+    using Origin = ParserTypes::Origin;
+
+    static constexpr Origin noSet = std::numeric_limits<Origin>::max();
+
+    // A deque so that references to the sets stay valid while new ones are created
+    std::deque<StateSetT> sets;
+    std::vector<Origin> setIndices;
+
+  public:
+    // One past the last position that has a set
+    std::size_t size() const
+    {
+        return setIndices.size();
+    }
+
+    bool empty() const
+    {
+        return setIndices.empty();
+    }
+
+    bool contains(std::size_t position) const
+    {
+        return position < setIndices.size() && setIndices[position] != noSet;
+    }
+
+    // Creates the set if there's none at that position yet
+    StateSetT& operator[](std::size_t position)
+    {
+        if (position >= setIndices.size())
+        {
+            setIndices.resize(position + 1, noSet);
+        }
+
+        auto& index = setIndices[position];
+        if (index == noSet)
+        {
+            index = static_cast<Origin>(sets.size());
+            sets.emplace_back();
+        }
+
+        return sets[index];
+    }
+
+    // Positions without a set read as an empty set
+    const StateSetT& operator[](std::size_t position) const
+    {
+        static const StateSetT emptySet;
+        return contains(position) ? sets[setIndices[position]] : emptySet;
+    }
+
+    const StateSetT& back() const
+    {
+        return (*this)[size() - 1];
+    }
+};
+
+// Terminal matches answered from the memo and those that had to call the matcher
+struct MatchStats
+{
+    std::size_t hits{};
+    std::size_t misses{};
+};
+
+// What parseChart keeps of how the items were derived, for parseTree
+enum class ChartMode : std::uint8_t
+{
+    // Every derivation in a shared packed parse forest, see ParseForest
+    Forest,
+    // The back-pointer of each item to the derivation the tree takes, see BackPointer
+    BackPointers,
+    // Only the items, parseTree finds the derivations of the tree back from them, what parseChartLR0 builds and the default
+    Items,
 };
 
 template <typename ParserTypes>
 struct ParseChart
 {
-    std::vector<StateSet<ParserTypes>> S;
+    StateSets<ParserTypes> S;
+    ChartMode mode = ChartMode::Items;
     bool completeMatch = false;
     std::size_t matchCount{};
+
+    // The items the lookahead kept out of the last set, only when the parse failed, parseError reports them with the set's
+    std::vector<Item<ParserTypes>> droppedPredictions;
+
+    // Length returned by the matcher for each terminal tried at each position, by Grammar::terminalIds
+    // A single array for all the sets, each one's range is sorted by terminal id once the set is processed
+    std::vector<std::pair<std::uint32_t, int>> terminalMatches;
+
+    // Mutable so parseTree can count its lookups too
+    mutable MatchStats matchStats;
+
+    ParseForest<ParserTypes> forest;
+
+    // Set when the parse started from another non-terminal than the grammar's start symbol, see Grammar::Start
+    std::optional<typename ParserTypes::NonTerminal> startSymbol;
+
+    // The non-terminal the matches are of
+    const typename ParserTypes::NonTerminal& rootSymbol(const Grammar<ParserTypes>& grammar) const
+    {
+        return startSymbol ? *startSymbol : grammar.startSymbol;
+    }
+
+    // Where the terminals expected at a position start, past the input skipped there
+    std::size_t terminalStart(std::size_t position) const
+    {
+        return position + S[position].skipped;
+    }
+
+    // The memoized length of a terminal at a position, if it was tried there
+    std::optional<int> findMatch(std::size_t position, std::uint32_t terminal) const
+    {
+        const auto& set = S[position];
+        const auto begin = terminalMatches.begin() + set.matchesBegin;
+        const auto end = terminalMatches.begin() + set.matchesEnd;
+
+        const auto it = std::lower_bound(begin, end, terminal, [](const auto& match, std::uint32_t terminal) { return match.first < terminal; });
+        return it != end && it->first == terminal ? std::optional{it->second} : std::nullopt;
+    }
 };
 
-template<typename ParserTypes>
-static ParseChart<ParserTypes> parseChart(const Grammar<ParserTypes>& grammar, const typename ParserTypes::Matcher& matcher, typename ParserTypes::Src src)
+// What parseChart does with an item, by the symbol after its dot
+enum class PostdotKind : std::uint8_t
+{
+    Complete,
+    NonTerminal,
+    // The item past it is also added right away
+    NullableNonTerminal,
+    Terminal,
+};
+
+// How parseChart looks up the dotted rules and their predictions and matches the terminals, here from the grammar's tables
+// A parser generated for a grammar, see tools/larley-gen, has its own with the same members made of switches
+template <typename ParserTypes>
+struct GrammarDispatch
+{
+    const Grammar<ParserTypes>& grammar;
+    const typename ParserTypes::Matcher& matcher;
+
+    PostdotKind kind(std::uint32_t dottedRule) const
+    {
+        const auto* symbol = grammar.getPostdotSymbol(dottedRule);
+        if (!symbol)
+        {
+            return PostdotKind::Complete;
+        }
+
+        if (const auto* nt = std::get_if<0>(symbol))
+        {
+            return grammar.nullables.contains(*nt) ? PostdotKind::NullableNonTerminal : PostdotKind::NonTerminal;
+        }
+
+        return PostdotKind::Terminal;
+    }
+
+    // Calls `onPredicted(dottedRule)` for each dotted rule of one of Grammar::predictions
+    void forEachPredicted(std::uint32_t prediction, const auto& onPredicted) const
+    {
+        for (const auto dottedRule : grammar.predictions[prediction])
+        {
+            onPredicted(dottedRule);
+        }
+    }
+
+    // Length of a terminal at `index` like the matcher returns it, `terminalId` is the terminal's Grammar::terminalIds
+    int match(typename ParserTypes::Src src, std::size_t index, std::uint32_t terminalId, const typename ParserTypes::Terminal& terminal) const
+    {
+        return matcher(src, index, terminal);
+    }
+};
+
+namespace impl
+{
+    // The set's matches are the last ones added to the chart
+    template <typename ParserTypes>
+    void sortMatches(ParseChart<ParserTypes>& chart, auto& set)
+    {
+        set.matchesEnd = chart.terminalMatches.size();
+        std::sort(chart.terminalMatches.begin() + set.matchesBegin, chart.terminalMatches.end());
+    }
+
+    // The complete dotted rule of the first rule of each non-terminal deriving the empty string, the one chartTree takes for
+    // a symbol spanning nothing
+    template <typename ParserTypes>
+    std::vector<std::uint32_t> emptyRules(const Grammar<ParserTypes>& grammar)
+    {
+        std::vector<std::uint32_t> emptyRules(grammar.productCount, std::numeric_limits<std::uint32_t>::max());
+        for (const auto& rule : grammar.rules)
+        {
+            const auto nullable = std::ranges::all_of(rule.symbols, [&](const auto& symbol)
+            {
+                const auto* nt = std::get_if<0>(&symbol);
+                return nt && grammar.nullables.contains(*nt);
+            });
+
+            auto& emptyRule = emptyRules[grammar.productIds[rule.id]];
+            if (nullable && emptyRule == std::numeric_limits<std::uint32_t>::max())
+            {
+                emptyRule = grammar.ruleToDottedRule[rule.id] + static_cast<std::uint32_t>(rule.symbols.size());
+            }
+        }
+
+        return emptyRules;
+    }
+
+    template <typename ParserTypes>
+    void countMatches(const Grammar<ParserTypes>& grammar, ParseChart<ParserTypes>& chart, typename ParserTypes::Src src)
+    {
+        const auto& S = chart.S;
+
+        if (chart.terminalStart(S.size() - 1) == src.size())
+        {
+            chart.completeMatch = true;
+        }
+
+        for (const auto& item : S.back())
+        {
+            if (item.start == 0 && grammar.isComplete(item.dottedRule) && grammar.getRule(item.dottedRule).product == chart.rootSymbol(grammar))
+            {
+                chart.matchCount++;
+            }
+        }
+    }
+
+    // Each terminal is matched at most once per position, the lengths are also kept in the chart for parseTree
+    // The terminals of a set are matched past the input the skipper skips at its position
+    // Scanned is what the recognizer gets back for a match, its item or the index of it
+    template <typename ParserTypes, typename Scanned, typename Dispatch = GrammarDispatch<ParserTypes>>
+    class Scanner
+    {
+        static constexpr auto noPosition = std::numeric_limits<std::size_t>::max();
+
+        const Grammar<ParserTypes>& grammar;
+        const Dispatch& dispatch;
+        const typename ParserTypes::Skipper& skipper;
+        typename ParserTypes::Src src;
+        ParseChart<ParserTypes>& chart;
+
+        // Where the terminals of the current set start
+        std::size_t start{};
+
+        std::vector<std::size_t> matchedAt;
+        std::vector<int> matchLengths;
+
+    public:
+        Scanner(const Grammar<ParserTypes>& grammar, const Dispatch& dispatch, const typename ParserTypes::Skipper& skipper, typename ParserTypes::Src src, ParseChart<ParserTypes>& chart)
+            : grammar(grammar), dispatch(dispatch), skipper(skipper), src(src), chart(chart),
+              matchedAt(grammar.terminalCount, noPosition), matchLengths(grammar.terminalCount)
+        {
+        }
+
+        // Called before scanning a set, the skipped length is kept in the chart
+        void skip(std::size_t position)
+        {
+            if (skipper)
+            {
+                chart.S[position].skipped = std::min(skipper(src, position), src.size() - position);
+            }
+
+            start = chart.terminalStart(position);
+        }
+
+        // `onMatch(item, end)` is called if the postdot terminal of `dottedRule` matches
+        void scan(std::size_t position, std::uint32_t dottedRule, const Scanned& item, const auto& onMatch)
+        {
+            const auto terminalId = grammar.terminalIds[dottedRule];
+            if (matchedAt[terminalId] == position)
+            {
+                chart.matchStats.hits++;
+            }
+            else
+            {
+                chart.matchStats.misses++;
+                matchedAt[terminalId] = position;
+
+                matchLengths[terminalId] = dispatch.match(src, start, terminalId, std::get<1>(*grammar.getPostdotSymbol(dottedRule)));
+                chart.terminalMatches.emplace_back(terminalId, matchLengths[terminalId]);
+            }
+
+            if (matchLengths[terminalId] > 0)
+            {
+                onMatch(item, start + matchLengths[terminalId]);
+            }
+        }
+    };
+}
+
+// Dispatch is GrammarDispatch or the one of a generated parser, both give the same chart
+// The input is matched against the start symbol, or against `start` when it's set
+template<typename ParserTypes, typename Dispatch = GrammarDispatch<ParserTypes>>
+static ParseChart<ParserTypes> parseChart(const Grammar<ParserTypes>& grammar, const typename ParserTypes::Matcher& matcher, typename ParserTypes::Src src, const typename ParserTypes::Skipper& skipper = {}, ChartMode mode = ChartMode::Items, const std::optional<typename Grammar<ParserTypes>::Start>& start = {})
 {
+    using ItemT = Item<ParserTypes>;
+    using Origin = ItemT::Origin;
+
+    if (src.size() >= std::numeric_limits<Origin>::max())
+    {
+        throw std::length_error("input too large for the parser's Origin type");
+    }
+
     ParseChart<ParserTypes> result;
+    result.mode = mode;
+
+    auto startPrediction = grammar.startPrediction;
+    if (start)
+    {
+        result.startSymbol = start->symbol;
+        startPrediction = start->prediction;
+    }
 
     auto& S = result.S;
-    S.resize(src.size() + 1);
 
-    std::vector<bool> ruleStarted;
-    ruleStarted.resize(grammar.rules.size());
+    constexpr auto noPosition = std::numeric_limits<std::size_t>::max();
 
-    const auto addItem = [&](auto& set, Item<ParserTypes>&& item)
+    // Only the set being processed receives items that start at its own position, those are deduplicated by dotted rule
+    // with the position of the set they were last added to, the others go through the set's ItemTable
+    std::vector<std::size_t> addedAt(grammar.dottedRules.size(), noPosition);
+    std::vector<std::size_t> predictedAt(grammar.predictions.size(), noPosition);
+
+    using BackPointerT = BackPointer<ParserTypes>;
+
+    const auto emptyRules = mode == ChartMode::BackPointers ? impl::emptyRules(grammar) : std::vector<std::uint32_t>{};
+
+    // The rule chartTree compares a child on, a terminal is the only one that can follow the item's predecessor
+    // The child of a chain's top is the link below it, or the item completed into the chain if there's none
+    const auto childRule = [&](const auto& set, std::uint32_t dottedRule, const BackPointerT& backPointer)
+    {
+        if (backPointer.child == BackPointerT::terminal)
+        {
+            return BackPointerT::terminal;
+        }
+
+        if (backPointer.child == BackPointerT::empty)
+        {
+            return emptyRules[grammar.postdotProductIds[dottedRule - 1]];
+        }
+
+        const auto& child = set[backPointer.child & ~BackPointerT::leoChain];
+        if (backPointer.child & BackPointerT::leoChain)
+        {
+            const auto& transitive = *S[child.start].transitives.find(grammar.getRule(child.dottedRule).product)->second;
+            if (transitive.topChild != transitive.noChild)
+            {
+                return transitive.topChild;
+            }
+        }
+
+        return child.dottedRule;
+    };
+
+    struct ChildKey
+    {
+        std::uint32_t rule;
+        std::size_t end;
+    };
+
+    std::vector<ChildKey> keys;
+    std::vector<ChildKey> currentKeys;
+
+    // The back-pointers of the sets from the one being processed on can still be replaced, a comparison that read one is made
+    // again once that set is done
+    std::size_t processed{};
+    bool readUnsettled = false;
+
+    // The children of an item from its last one to its first one, along the back-pointers
+    const auto childKeys = [&](std::size_t setIndex, std::uint32_t index, std::vector<ChildKey>& keys)
+    {
+        keys.clear();
+
+        const auto item = S[setIndex][index];
+        auto dottedRule = item.dottedRule;
+        for (auto dot = grammar.getDot(dottedRule); dot > 0; dot--, dottedRule--)
+        {
+            if (item.start == setIndex)
+            {
+                keys.push_back({emptyRules[grammar.postdotProductIds[dottedRule - 1]], setIndex});
+                continue;
+            }
+
+            const auto& set = S[setIndex];
+            const auto backPointer = set.backPointers[index];
+            keys.push_back({childRule(set, dottedRule, backPointer), setIndex});
+            setIndex = backPointer.split;
+            index = backPointer.predecessor;
+        }
+    };
+
+    // Whether the predecessor at `split` is preferred to the one at `currentSplit`, predecessors at different sets differ by
+    // the end of a child so they're compared from their first one
+    const auto predecessorPreferred = [&](std::size_t split, std::uint32_t predecessor, std::size_t currentSplit, std::uint32_t currentPredecessor)
+    {
+        readUnsettled |= std::max(split, currentSplit) >= processed;
+
+        childKeys(split, predecessor, keys);
+        childKeys(currentSplit, currentPredecessor, currentKeys);
+        for (auto x = keys.size(); x > 0; x--)
+        {
+            const auto& key = keys[x - 1];
+            const auto& currentKey = currentKeys[x - 1];
+            if (key.rule != currentKey.rule)
+            {
+                return key.rule < currentKey.rule;
+            }
+
+            if (key.end != currentKey.end)
+            {
+                return key.end > currentKey.end;
+            }
+        }
+
+        return false;
+    };
+
+    // The derivations of the items down the last children of an item, as long as they're links of a chain, `link` tells if
+    // the next one is, otherwise the child is the item of the set at `child`
+    struct Level
+    {
+        std::size_t split;
+        std::uint32_t predecessor;
+        std::uint32_t childRule;
+        std::uint32_t child;
+        bool link;
+    };
+
+    std::vector<Level> levels;
+    std::vector<Level> currentLevels;
+
+    // The derivation of an item of the set by its back-pointer, and those of the links of the chain it's the top of
+    const auto derivations = [&](const auto& set, std::uint32_t dottedRule, const BackPointerT& backPointer, std::vector<Level>& levels)
+    {
+        const auto child = backPointer.child & ~BackPointerT::leoChain;
+        levels.assign(1, {backPointer.split, backPointer.predecessor, childRule(set, dottedRule, backPointer), child, false});
+        if (!(backPointer.child & BackPointerT::leoChain))
+        {
+            return;
+        }
+
+        // The links are found from the item completed into the chain, from the first one up
+        const auto first = levels.size();
+        auto [linkChild, split] = set[child];
+        while (true)
+        {
+            const auto& transitive = *S[split].transitives.find(grammar.getRule(linkChild).product)->second;
+            const auto link = transitive.penultimate.advanced();
+            if (link == transitive.top)
+            {
+                break;
+            }
+
+            levels.push_back({split, transitive.penultimateIndex, linkChild, child, false});
+            linkChild = link.dottedRule;
+            split = link.start;
+        }
+
+        std::reverse(levels.begin() + first, levels.end());
+        for (auto x = first; x < levels.size(); x++)
+        {
+            levels[x - 1].link = true;
+        }
+    };
+
+    // Whether `candidate` derives `item` the way chartTree takes rather than `current`
+    // chartTree takes each child's derivation on its own, a link of a chain has none in the set so the candidates are compared
+    // down to where they differ
+    const auto preferred = [&](const auto& set, ItemT item, const BackPointerT& candidate, const BackPointerT& current)
+    {
+        if (candidate.split != current.split)
+        {
+            return predecessorPreferred(candidate.split, candidate.predecessor, current.split, current.predecessor);
+        }
+
+        const auto rule = childRule(set, item.dottedRule, candidate);
+        const auto currentRule = childRule(set, item.dottedRule, current);
+        if (rule != currentRule || !((candidate.child | current.child) & BackPointerT::leoChain))
+        {
+            return rule < currentRule;
+        }
+
+        derivations(set, item.dottedRule, candidate, levels);
+        derivations(set, item.dottedRule, current, currentLevels);
+        for (std::size_t x = 1;; x++)
+        {
+            // The same item of the set has the same derivation
+            if (!levels[x - 1].link && !currentLevels[x - 1].link)
+            {
+                return false;
+            }
+
+            for (auto* sideLevels : {&levels, &currentLevels})
+            {
+                if (sideLevels->size() == x)
+                {
+                    readUnsettled = true;
+
+                    const auto child = sideLevels->back().child;
+                    const auto& backPointer = set.backPointers[child];
+                    sideLevels->push_back({backPointer.split, backPointer.predecessor, childRule(set, set[child].dottedRule, backPointer), backPointer.child, false});
+                }
+            }
+
+            const auto& level = levels[x];
+            const auto& currentLevel = currentLevels[x];
+            if (level.split != currentLevel.split)
+            {
+                return predecessorPreferred(level.split, level.predecessor, currentLevel.split, currentLevel.predecessor);
+            }
+
+            if (level.childRule != currentLevel.childRule)
+            {
+                return level.childRule < currentLevel.childRule;
+            }
+        }
+    };
+
+    // A derivation that lost to the one of its item in a comparison that read unsettled back-pointers
+    struct Unsettled
+    {
+        std::size_t set;
+        std::uint32_t index;
+        BackPointerT backPointer;
+    };
+
+    std::vector<Unsettled> unsettled;
+
+    // A duplicate item with a back-pointer replaces the one of the item in the set if it's preferred
+    const auto addItem = [&](auto& set, std::size_t setIndex, ItemT item, std::uint32_t node, const BackPointerT& backPointer)
     {
         if constexpr (true)
         {
-            if (item.dot == 0)
+            if (item.start == setIndex)
             {
-                if (ruleStarted[item.rule.id])
+                if (addedAt[item.dottedRule] == setIndex)
                 {
                     return;
                 }
 
-                ruleStarted[item.rule.id] = true;
+                addedAt[item.dottedRule] = setIndex;
+                set.add(grammar, item, node);
+                if (mode == ChartMode::BackPointers)
+                {
+                    set.backPointers.push_back(backPointer);
+                }
             }
+            else if (mode == ChartMode::BackPointers)
+            {
+                const auto index = set.added.insert(item, static_cast<std::uint32_t>(set.size()));
+                if (index == set.size())
+                {
+                    set.add(grammar, item, node);
+                    set.backPointers.push_back(backPointer);
+                }
+                else
+                {
+                    readUnsettled = false;
+
+                    auto& current = set.backPointers[index];
+                    auto lost = backPointer;
+                    if (preferred(set, item, backPointer, current))
+                    {
+                        std::swap(lost, current);
+                    }
 
-            if (set.added.insert(item).second)
+                    if (readUnsettled)
+                    {
+                        unsettled.push_back({setIndex, index, lost});
+                    }
+                }
+            }
+            else if (set.added.insert(item))
             {
-                set.push_back(std::move(item));
+                set.add(grammar, item, node);
             }
         }
         else
         {
             if (std::find(set.begin(), set.end(), item) == set.end())
             {
-                set.push_back(std::move(item));
+                set.add(grammar, item, node);
             }
         }
     };
 
-    std::unordered_map<typename ParserTypes::NonTerminal, std::vector<const Rule<ParserTypes>*>> productToRules;
-    for (const auto& rule : grammar.rules)
+    // The parse forest is built along, an item's node only depends on its dotted rule and span so a duplicate item has the
+    // same node as the one already in the set, what differs is the packed node it adds
+    using Forest = ParseForest<ParserTypes>;
+    constexpr auto noNode = Forest::noNode;
+
+    auto& forest = result.forest;
+    forest = Forest{static_cast<std::uint32_t>(grammar.dottedRules.size()), grammar.productCount};
+
+    // Scott's MAKE_NODE, the node of `dottedRule` over [start, end) derived from `left`, the node of the symbols before the
+    // last one before the dot, and `right`, the node of that last one
+    const auto makeNode = [&](std::uint32_t dottedRule, std::size_t start, std::size_t end, std::uint32_t left, std::uint32_t right)
     {
-        productToRules[rule.product].push_back(&rule);
-    }
+        const auto& [rule, dot] = grammar.dottedRules[dottedRule];
+        const auto complete = dot == grammar.rules[rule].symbols.size();
+        if (dot == 1 && !complete)
+        {
+            return right;
+        }
+
+        const auto node = forest.getNode(complete ? forest.symbolLabel(grammar.productIds[rule]) : dottedRule, start, end);
+        forest.addPacked(node, dottedRule, left, right);
+        return node;
+    };
 
-    for (const auto* rule : productToRules.at(grammar.startSymbol))
+    // The node of a non-terminal deriving the empty string at `position`, its packed nodes come from its rules completing there
+    const auto emptyNode = [&](std::uint32_t productId, std::size_t position)
     {
-        addItem(S[0], {*rule, 0, 0});
-    }
+        return forest.getNode(forest.symbolLabel(productId), position, position);
+    };
+
+    // Node of an item the prediction closure skipped nullable symbols for, they all derive the empty string at `position`
+    const auto nullablePrefix = [&](this auto const& nullablePrefix, std::uint32_t dottedRule, std::size_t position) -> std::uint32_t
+    {
+        if (grammar.getDot(dottedRule) == 0)
+        {
+            return noNode;
+        }
+
+        const auto previous = dottedRule - 1;
+        return makeNode(dottedRule, position, position, nullablePrefix(previous, position), emptyNode(grammar.postdotProductIds[previous], position));
+    };
+
+    // Adds `item` derived from its predecessor and a child ending at `setIndex`, only what the chart's mode keeps is made,
+    // its back-pointer or the node `forestNode()` makes
+    const auto addDerived = [&](auto& set, std::size_t setIndex, ItemT item, const BackPointerT& backPointer, const auto& forestNode)
+    {
+        addItem(set, setIndex, item, mode == ChartMode::Forest ? forestNode() : noNode, backPointer);
+    };
+
+    const Dispatch dispatch{grammar, matcher};
+
+    // Scans are kept by the index of their item in the set being processed
+    impl::Scanner<ParserTypes, std::size_t, Dispatch> scanner(grammar, dispatch, skipper, src, result);
+
+    // The predictions the lookahead dropped in the set at `droppedAt`, the last one's are kept if the parse fails
+    std::vector<std::uint32_t> dropped;
+    auto droppedAt = noPosition;
 
+    // A predicted item that can't be empty is dropped if it can't start with the symbol at its position, it would die right away
+    const auto canStart = [&](std::uint32_t dottedRule, std::size_t position)
+    {
+        if constexpr (Grammar<ParserTypes>::HasLookahead)
+        {
+            if (grammar.nullableSuffixes[dottedRule])
+            {
+                return true;
+            }
+
+            const auto start = result.terminalStart(position);
+            if (start < src.size() && grammar.firstSets[dottedRule][TerminalLookahead<typename ParserTypes::Terminal>::at(src, start)])
+            {
+                return true;
+            }
+
+            if (droppedAt != position)
+            {
+                dropped.clear();
+                droppedAt = position;
+            }
+
+            dropped.push_back(dottedRule);
+            return false;
+        }
+        else
+        {
+            return true;
+        }
+    };
+
+    // Adds a whole precomputed closure at once, at most once per set
+    const auto predict = [&](auto& set, std::size_t setIndex, std::uint32_t prediction)
+    {
+        if (predictedAt[prediction] == setIndex)
+        {
+            return;
+        }
+
+        predictedAt[prediction] = setIndex;
+        dispatch.forEachPredicted(prediction, [&](std::uint32_t dottedRule)
+        {
+            if (canStart(dottedRule, setIndex))
+            {
+                addItem(set, setIndex, {dottedRule, static_cast<Origin>(setIndex)}, mode == ChartMode::Forest ? nullablePrefix(dottedRule, setIndex) : noNode, {});
+            }
+        });
+    };
+
+    // Only called for sets that are already complete
+    const auto findTransitive = [&](this auto const& findTransitive, std::size_t setIndex, typename ParserTypes::NonTerminal symbol) -> const TransitiveItem<ParserTypes>*
+    {
+        auto& transitives = S[setIndex].transitives;
+        if (const auto it = transitives.find(symbol); it != transitives.end())
+        {
+            return it->second ? &*it->second : nullptr;
+        }
+
+        // Placeholder, also guards against cycles through nullable prefixes
+        auto& transitive = transitives[symbol];
+
+        const auto* waiting = S[setIndex].findWaiting(symbol);
+        if (!waiting || waiting->count != 1)
+        {
+            return nullptr;
+        }
+
+        const auto penultimate = S[setIndex][waiting->first];
+        const auto completed = penultimate.advanced();
+        if (!grammar.isComplete(completed.dottedRule))
+        {
+            return nullptr;
+        }
+
+        const auto index = static_cast<std::uint32_t>(waiting->first);
+        TransitiveItem<ParserTypes> item{completed, penultimate, S[setIndex].nodes[index], index, static_cast<Origin>(setIndex), index, TransitiveItem<ParserTypes>::noChild};
+        if (penultimate.start < setIndex)
+        {
+            if (const auto* above = findTransitive(penultimate.start, grammar.getRule(penultimate.dottedRule).product))
+            {
+                item.top = above->top;
+                item.topSplit = above->topSplit;
+                item.topPredecessor = above->topPredecessor;
+                item.topChild = above->topChild != item.noChild ? above->topChild : completed.dottedRule;
+            }
+        }
+
+        transitive = item;
+        return &*transitive;
+    };
+
+    scanner.skip(0);
+    predict(S[0], 0, startPrediction);
+
+    // S grows as terminals are matched, the loop stops after the last position any item reached
     for (std::size_t stateIndex = 0; stateIndex < S.size(); stateIndex++)
     {
+        if (!S.contains(stateIndex))
+        {
+            continue;
+        }
+
         auto& set = S[stateIndex];
+        set.matchesBegin = result.terminalMatches.size();
+        processed = stateIndex;
+        scanner.skip(stateIndex);
 
-        ruleStarted.resize(0);
-        ruleStarted.resize(grammar.rules.size());
+        // The terminal's node starts at the set's position like the items, see ParseChart::terminalStart
+        const auto scanned = [&](std::size_t itemIndex, std::size_t end)
+        {
+            const auto item = set[itemIndex];
+            const auto advanced = item.advanced();
+            addDerived(S[end], end, advanced, {static_cast<Origin>(stateIndex), static_cast<std::uint32_t>(itemIndex), BackPointerT::terminal}, [&]
+            {
+                const auto terminal = forest.getNode(forest.terminalLabel(grammar.terminalIds[item.dottedRule]), stateIndex, end);
+                return makeNode(advanced.dottedRule, item.start, end, set.nodes[itemIndex], terminal);
+            });
+        };
 
         for (std::size_t itemIndex = 0; itemIndex < set.size(); itemIndex++)
         {
             const auto item = set[itemIndex];
+            const auto kind = dispatch.kind(item.dottedRule);
 
-            if (item.isComplete())
+            if (kind == PostdotKind::Complete)
             {
-                const auto& potentialSet = S[item.start];
-                for (std::size_t potentialIndex = 0; potentialIndex < potentialSet.size(); potentialIndex++)
+                const auto& product = grammar.getRule(item.dottedRule).product;
+                const auto productId = grammar.productIds[grammar.dottedRules[item.dottedRule].rule];
+
+                // Only an empty rule completes without a node, it gets an empty packed node
+                auto node = set.nodes[itemIndex];
+                if (mode == ChartMode::Forest && node == noNode)
                 {
-                    const auto& potentialItem = potentialSet[potentialIndex];
-                    if (potentialItem.isAtSymbol(item.rule.product))
+                    node = emptyNode(productId, stateIndex);
+                    forest.addPacked(node, item.dottedRule, noNode, noNode);
+                    set.nodes[itemIndex] = node;
+                }
+
+                if (item.start < stateIndex)
+                {
+                    // The nodes of the chain are only made once the forest is done, for the chains the root reaches, see below
+                    if (const auto* transitive = findTransitive(item.start, product))
                     {
-                        addItem(set, potentialItem.advanced());
+                        const auto& top = transitive->top;
+                        addDerived(set, stateIndex, top, {transitive->topSplit, transitive->topPredecessor, static_cast<std::uint32_t>(itemIndex) | BackPointerT::leoChain}, [&]
+                        {
+                            const auto topNode = forest.getNode(forest.symbolLabel(grammar.productIds[grammar.dottedRules[top.dottedRule].rule]), top.start, stateIndex);
+                            forest.addPacked(topNode, item.dottedRule, Forest::pendingChain, node);
+                            return topNode;
+                        });
+
+                        continue;
                     }
                 }
 
-                continue;
-            }
-
-            const auto& symbol = item.rule.symbols[item.dot];
+                const auto& potentialSet = S[item.start];
+                const auto* waiting = potentialSet.findWaiting(product);
+                if (!waiting)
+                {
+                    continue;
+                }
 
-            if (auto* nt = std::get_if<0>(&symbol))
-            {
-                if (grammar.nullables.contains(*nt))
+                // The list can grow while iterating when the item started in the current set
+                for (auto waitingIndex = waiting->first; waitingIndex != potentialSet.noItem; waitingIndex = potentialSet.nextWaiting[waitingIndex])
                 {
-                    addItem(set, item.advanced());
+                    const auto waitingItem = potentialSet[waitingIndex];
+                    const auto advanced = waitingItem.advanced();
+                    addDerived(set, stateIndex, advanced, {item.start, static_cast<std::uint32_t>(waitingIndex), static_cast<std::uint32_t>(itemIndex)}, [&] { return makeNode(advanced.dottedRule, waitingItem.start, stateIndex, potentialSet.nodes[waitingIndex], node); });
                 }
 
-                const auto it = productToRules.find(*nt);
-                if (it != productToRules.end())
+                continue;
+            }
+
+            if (kind == PostdotKind::Terminal)
+            {
+                scanner.scan(stateIndex, item.dottedRule, itemIndex, scanned);
+            }
+            else
+            {
+                if (kind == PostdotKind::NullableNonTerminal)
                 {
-                    for (const auto* rule : it->second)
+                    const auto advanced = item.advanced();
+                    addDerived(set, stateIndex, advanced, {static_cast<Origin>(stateIndex), static_cast<std::uint32_t>(itemIndex), BackPointerT::empty}, [&]
                     {
-                        addItem(set, {*rule, stateIndex, 0});
-                    }
+                        const auto empty = emptyNode(grammar.postdotProductIds[item.dottedRule], stateIndex);
+                        return makeNode(advanced.dottedRule, item.start, stateIndex, set.nodes[itemIndex], empty);
+                    });
                 }
+
+                predict(set, stateIndex, grammar.dottedRuleToPrediction[item.dottedRule]);
             }
-            else if (auto* lt = std::get_if<1>(&symbol))
+        }
+
+        // A replaced back-pointer can change how the items derived from it compare, it's done once none is replaced
+        for (auto replaced = !unsettled.empty(); replaced;)
+        {
+            replaced = false;
+            for (auto& [setIndex, index, backPointer] : unsettled)
             {
-                const auto matchLength = matcher(src, stateIndex, *lt);
-                if (matchLength > 0)
+                auto& unsettledSet = S[setIndex];
+                if (preferred(unsettledSet, unsettledSet[index], backPointer, unsettledSet.backPointers[index]))
                 {
-                    addItem(S[stateIndex + matchLength], item.advanced());
+                    std::swap(backPointer, unsettledSet.backPointers[index]);
+                    replaced = true;
                 }
             }
         }
+
+        unsettled.clear();
+
+        set.added.clear();
+        impl::sortMatches(result, set);
     }
 
-    std::size_t setCount{};
-    for (std::size_t index{}; index < S.size(); index++)
+    impl::countMatches(grammar, result, src);
+
+    // Closures overlap, a dotted rule can be dropped by more than one of the set's predictions
+    if (droppedAt == S.size() - 1 && (result.matchCount == 0 || !result.completeMatch))
     {
-        if (!S[index].empty())
+        std::ranges::sort(dropped);
+        const auto [first, last] = std::ranges::unique(dropped);
+        dropped.erase(first, last);
+
+        for (const auto dottedRule : dropped)
         {
-            setCount = index + 1;
+            result.droppedPredictions.push_back({dottedRule, static_cast<Origin>(droppedAt)});
         }
     }
-    S.resize(setCount);
 
-    if (S.size() == src.size() + 1)
+    if (result.matchCount == 0 || mode != ChartMode::Forest)
+    {
+        return result;
+    }
+
+    const auto& lastSet = S.back();
+    for (std::size_t itemIndex = 0; itemIndex < lastSet.size(); itemIndex++)
     {
-        result.completeMatch = true;
+        const auto& item = lastSet[itemIndex];
+        if (item.start == 0 && grammar.isComplete(item.dottedRule) && grammar.getRule(item.dottedRule).product == result.rootSymbol(grammar))
+        {
+            forest.root = lastSet.nodes[itemIndex];
+            break;
+        }
     }
 
-    for (const auto& item : S.back())
+    // A chain climbs from the node of the item that completed into it, each link's penultimate item completed by the node below
+    const auto expandChain = [&](std::uint32_t dottedRule, std::uint32_t node)
+    {
+        const auto end = forest.nodes[node].end;
+        auto setIndex = static_cast<std::size_t>(forest.nodes[node].start);
+        auto symbol = grammar.getRule(dottedRule).product;
+
+        while (true)
+        {
+            const auto& transitive = *S[setIndex].transitives.find(symbol)->second;
+            const auto& penultimate = transitive.penultimate;
+            const auto completed = penultimate.advanced();
+
+            node = makeNode(completed.dottedRule, penultimate.start, end, transitive.penultimateNode, node);
+            if (completed == transitive.top)
+            {
+                return;
+            }
+
+            setIndex = penultimate.start;
+            symbol = grammar.getRule(completed.dottedRule).product;
+        }
+    };
+
+    // Leo's transitive items skip the nodes of their chain, they're made for the chains the root reaches so the forest is complete
+    // from the root, a right recursive list only gets the nodes of its own derivation
+    std::vector<bool> visited;
+    std::vector<std::uint32_t> stack{forest.root};
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> chains;
+    while (!stack.empty())
     {
-        if (item.start == 0 && item.isComplete() && item.rule.product == grammar.startSymbol)
+        const auto node = stack.back();
+        stack.pop_back();
+
+        if (node >= visited.size())
+        {
+            visited.resize(forest.nodes.size());
+        }
+
+        if (visited[node])
+        {
+            continue;
+        }
+
+        visited[node] = true;
+
+        chains.clear();
+        for (auto* id = &forest.nodes[node].firstPacked; *id != noNode;)
         {
-            result.matchCount++;
+            auto& packed = forest.packed[*id];
+            if (packed.left == Forest::pendingChain)
+            {
+                chains.emplace_back(packed.dottedRule, packed.right);
+                *id = packed.next;
+            }
+            else
+            {
+                id = &packed.next;
+            }
+        }
+
+        for (const auto& [dottedRule, chain] : chains)
+        {
+            expandChain(dottedRule, chain);
+        }
+
+        for (auto id = forest.nodes[node].firstPacked; id != noNode; id = forest.packed[id].next)
+        {
+            for (const auto child : {forest.packed[id].left, forest.packed[id].right})
+            {
+                if (child != noNode)
+                {
+                    stack.push_back(child);
+                }
+            }
         }
     }
 
@@ -28,27 +28,37 @@ namespace impl
     void buildPath(const auto& grammar, auto& ParseChart, auto& path)
     {
         const auto& lastItem = *path.back();
+        const auto& NT = grammar.getRule(lastItem.dottedRule).product;
 
-        if (lastItem.start == 0 && lastItem.rule.product == grammar.startSymbol)
+        if (lastItem.start == 0 && NT == grammar.startSymbol)
         {
             return;
         }
 
-        const auto& NT = lastItem.rule.product;
-
-        for (const auto& item : ParseChart.S[lastItem.start])
+        // The predictions the lookahead dropped from the last set can be on the path too
+        const auto follow = [&](const auto& items)
         {
-            if (std::ranges::contains(path, &item))
+            for (const auto& item : items)
             {
-                continue;
+                if (std::ranges::contains(path, &item))
+                {
+                    continue;
+                }
+
+                if (const auto* postdot = grammar.getPostdotNonTerminal(item.dottedRule); postdot && *postdot == NT)
+                {
+                    path.push_back(&item);
+                    buildPath(grammar, ParseChart, path);
+                    return true;
+                }
             }
 
-            if (item.isAtSymbol(NT))
-            {
-                path.push_back(&item);
-                buildPath(grammar, ParseChart, path);
-                break;
-            }
+            return false;
+        };
+
+        if (!follow(ParseChart.S[lastItem.start]) && lastItem.start == ParseChart.S.size() - 1)
+        {
+            follow(ParseChart.droppedPredictions);
         }
     }
 }
@@ -64,26 +74,30 @@ ParseError<ParserTypes> parseError(const Grammar<ParserTypes>& grammar, const ty
         return error;
     }
 
-    error.position = S.size() - 1;
+    error.position = ParseChart.terminalStart(S.size() - 1);
 
-    const auto& set = S.back();
-    for (const auto& item : set)
+    const auto report = [&](const auto& items)
     {
-        if (item.isComplete())
+        for (const auto& item : items)
         {
-            continue;
-        }
-
-        const auto& symbol = item.rule.symbols[item.dot];
+            const auto* symbol = grammar.getPostdotSymbol(item.dottedRule);
+            if (!symbol)
+            {
+                continue;
+            }
 
-        if (const auto* LT = std::get_if<1>(&symbol))
-        {
-            auto& prediction = error.predictions.emplace_back(*LT);
+            if (const auto* LT = std::get_if<1>(symbol))
+            {
+                auto& prediction = error.predictions.emplace_back(*LT);
 
-            prediction.path.push_back(&item);
-            impl::buildPath(grammar, ParseChart, prediction.path);
+                prediction.path.push_back(&item);
+                impl::buildPath(grammar, ParseChart, prediction.path);
+            }
         }
-    }
+    };
+
+    report(S.back());
+    report(ParseChart.droppedPredictions);
 
 	return error;
 }
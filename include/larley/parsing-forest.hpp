@@ -0,0 +1,265 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace larley
+{
+
+// Binarized shared packed parse forest (SPPF), built by parseChart as it adds the items, after Scott's "SPPF-style parsing from Earley recognisers"
+// Every derivation of the input is in it and they share their common parts, its size is linear in the chart's
+// A node is a symbol, an intermediate dotted rule or a terminal spanning [start, end), each of its packed nodes is one way to derive it
+// from the node of the symbols before the last one and the node of the last one
+template <typename ParserTypes>
+struct ParseForest
+{
+    using Origin = ParserTypes::Origin;
+
+    static constexpr std::uint32_t noNode = std::numeric_limits<std::uint32_t>::max();
+
+    // Left child of a packed node standing for a chain of Leo's transitive items parseChart didn't make the nodes of yet
+    // The right child is the node the chain starts from, only the nodes the root can't reach still have some
+    static constexpr std::uint32_t pendingChain = noNode - 1;
+
+    struct Node
+    {
+        // A dotted rule for an intermediate node, past those the Grammar::productIds of the symbol nodes then the Grammar::terminalIds
+        std::uint32_t label;
+        Origin start;
+        Origin end;
+
+        // Chained through Packed::next, noNode for a terminal
+        std::uint32_t firstPacked = noNode;
+    };
+
+    struct Packed
+    {
+        // The dotted rule the node was made for, the complete one of the rule that derived it for a symbol node
+        std::uint32_t dottedRule;
+
+        // The node of the symbols before the last one, noNode if there are none
+        // The first symbol stands for itself, there's no intermediate node for a dotted rule with a single symbol before the dot
+        std::uint32_t left;
+        std::uint32_t right;
+
+        std::uint32_t next;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<Packed> packed;
+
+    // The start symbol over what the chart matched, noNode if it didn't match or the recognizer doesn't build a forest
+    std::uint32_t root = noNode;
+
+    std::uint32_t dottedRuleCount{};
+    std::uint32_t productCount{};
+
+    ParseForest() = default;
+
+    ParseForest(std::uint32_t dottedRuleCount, std::uint32_t productCount) : dottedRuleCount{dottedRuleCount}, productCount{productCount}
+    {
+    }
+
+    std::uint32_t symbolLabel(std::uint32_t productId) const
+    {
+        return dottedRuleCount + productId;
+    }
+
+    std::uint32_t terminalLabel(std::uint32_t terminalId) const
+    {
+        return dottedRuleCount + productCount + terminalId;
+    }
+
+    bool isIntermediate(std::uint32_t node) const
+    {
+        return nodes[node].label < dottedRuleCount;
+    }
+
+    bool isTerminal(std::uint32_t node) const
+    {
+        return nodes[node].label >= dottedRuleCount + productCount;
+    }
+
+    // noNode if there's none
+    std::uint32_t findNode(std::uint32_t label, std::size_t start, std::size_t end) const
+    {
+        if (slots.empty())
+        {
+            return noNode;
+        }
+
+        for (auto index = slotIndex(label, start, end); slots[index] != noNode; index = (index + 1) & (slots.size() - 1))
+        {
+            if (matches(slots[index], label, start, end))
+            {
+                return slots[index];
+            }
+        }
+
+        return noNode;
+    }
+
+    // Creates the node if there's none with that label and span yet
+    std::uint32_t getNode(std::uint32_t label, std::size_t start, std::size_t end)
+    {
+        // Keeps the load factor under 1/2 like ItemTable
+        if ((nodes.size() + 1) * 2 > slots.size())
+        {
+            grow();
+        }
+
+        auto index = slotIndex(label, start, end);
+        for (; slots[index] != noNode; index = (index + 1) & (slots.size() - 1))
+        {
+            if (matches(slots[index], label, start, end))
+            {
+                return slots[index];
+            }
+        }
+
+        const auto node = static_cast<std::uint32_t>(nodes.size());
+        nodes.push_back({label, static_cast<Origin>(start), static_cast<Origin>(end)});
+        slots[index] = node;
+        return node;
+    }
+
+    // Nothing is added if the node already has that packed node, a node rarely has more than a few
+    void addPacked(std::uint32_t node, std::uint32_t dottedRule, std::uint32_t left, std::uint32_t right)
+    {
+        auto& first = nodes[node].firstPacked;
+        for (auto id = first; id != noNode; id = packed[id].next)
+        {
+            const auto& other = packed[id];
+            if (other.dottedRule == dottedRule && other.left == left && other.right == right)
+            {
+                return;
+            }
+        }
+
+        packed.push_back({dottedRule, left, right, first});
+        first = static_cast<std::uint32_t>(packed.size() - 1);
+    }
+
+    // Number of trees the root derives, saturated to the max of std::size_t, which is also what a cyclic forest gives
+    std::size_t countTrees() const
+    {
+        constexpr auto many = std::numeric_limits<std::size_t>::max();
+
+        if (root == noNode)
+        {
+            return 0;
+        }
+
+        enum class State : std::uint8_t
+        {
+            New,
+            Open,
+            Counted,
+        };
+
+        std::vector<State> states(nodes.size(), State::New);
+        std::vector<std::size_t> counts(nodes.size());
+
+        // A node is counted once it comes back on top, after its children, an open child is one of its ancestors
+        std::vector<std::uint32_t> stack{root};
+        while (!stack.empty())
+        {
+            const auto node = stack.back();
+            if (states[node] == State::New)
+            {
+                states[node] = State::Open;
+                for (auto id = nodes[node].firstPacked; id != noNode; id = packed[id].next)
+                {
+                    for (const auto child : {packed[id].left, packed[id].right})
+                    {
+                        if (child < pendingChain && states[child] == State::New)
+                        {
+                            stack.push_back(child);
+                        }
+                    }
+                }
+
+                continue;
+            }
+
+            stack.pop_back();
+            if (states[node] == State::Counted)
+            {
+                continue;
+            }
+
+            states[node] = State::Counted;
+            if (isTerminal(node))
+            {
+                counts[node] = 1;
+                continue;
+            }
+
+            std::size_t total = 0;
+            for (auto id = nodes[node].firstPacked; id != noNode; id = packed[id].next)
+            {
+                if (packed[id].left == pendingChain)
+                {
+                    continue;
+                }
+
+                std::size_t count = 1;
+                for (const auto child : {packed[id].left, packed[id].right})
+                {
+                    if (child == noNode)
+                    {
+                        continue;
+                    }
+
+                    const auto childCount = states[child] == State::Counted ? counts[child] : many;
+                    count = childCount != 0 && count > many / childCount ? many : count * childCount;
+                }
+
+                total = total > many - count ? many : total + count;
+            }
+
+            counts[node] = total;
+        }
+
+        return counts[root];
+    }
+
+  private:
+    // Open addressing index of the nodes by label and span, the keys are read back from `nodes`
+    std::vector<std::uint32_t> slots;
+    std::size_t shift{};
+
+    std::size_t slotIndex(std::uint32_t label, std::size_t start, std::size_t end) const
+    {
+        const auto key = (static_cast<std::uint64_t>(label) << 32) ^ (static_cast<std::uint64_t>(start) * 0x9E3779B97F4A7C15ull) ^ end;
+        return (key * 0x9E3779B97F4A7C15ull) >> shift;
+    }
+
+    bool matches(std::uint32_t node, std::uint32_t label, std::size_t start, std::size_t end) const
+    {
+        const auto& other = nodes[node];
+        return other.label == label && other.start == start && other.end == end;
+    }
+
+    void grow()
+    {
+        const auto capacity = slots.empty() ? 64 : slots.size() * 2;
+
+        slots.assign(capacity, noNode);
+        shift = 64 - std::countr_zero(capacity);
+
+        for (std::uint32_t node = 0; node < nodes.size(); node++)
+        {
+            auto index = slotIndex(nodes[node].label, nodes[node].start, nodes[node].end);
+            while (slots[index] != noNode)
+            {
+                index = (index + 1) & (slots.size() - 1);
+            }
+            slots[index] = node;
+        }
+    }
+};
+
+} // namespace larley
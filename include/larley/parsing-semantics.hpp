@@ -31,7 +31,7 @@ class Semantics
         template <typename T>
         const T& as() const
         {
-            return std::any_cast<T>(*this);
+            return std::any_cast<const T&>(*this);
         }
     };
 
@@ -76,48 +76,85 @@ class Semantics
 };
 
 template <typename ParserTypes>
-auto parseSemantics(const Semantics<ParserTypes>& semantics, const ParseTree<ParserTypes> tree, typename ParserTypes::Src src, typename ParserTypes::Ctx* ctx)
+auto parseSemantics(const Semantics<ParserTypes>& semantics, const ParseTree<ParserTypes>& tree, typename ParserTypes::Src src, typename ParserTypes::Ctx* ctx)
 {
     using SemanticValue = Semantics<ParserTypes>::SemanticValue;
     using SemanticValues = Semantics<ParserTypes>::SemanticValues;
 
-    std::size_t index = 0;
-    const auto iterate = [&](const auto& self) -> SemanticValue
+    // The values of the children of the edges being evaluated, those of each edge after those of its parent
+    SemanticValues values;
+    SemanticValues arguments;
+
+    // The children of an edge are on `values` from `first` on
+    const auto evaluate = [&](const Edge<ParserTypes>& edge, std::size_t first)
     {
         SemanticValue value;
-
-        const auto& edge = tree[index++];
         if (edge.rule)
         {
-            SemanticValues values;
-            for (int x = 0; x < edge.rule->symbols.size(); x++)
-            {
-                if (!edge.rule->isDiscarded(x))
-                {
-                    values.push_back(self(self));
-                }
-                else
-                {
-                    self(self);
-                }
-            }
+            arguments.assign(std::make_move_iterator(values.begin() + first), std::make_move_iterator(values.end()));
+            values.erase(values.begin() + first, values.end());
 
-            const auto& action = semantics.actions[edge.rule->id];
-            if (action)
+            // The rules after the last one with an action don't have one
+            const auto id = edge.rule->id;
+            if (id < semantics.actions.size() && semantics.actions[id])
             {
-                value = action(values, ctx);
+                value = semantics.actions[id](arguments, ctx);
             }
-            else if (values.size() > 0)
+            else if (arguments.size() > 0)
             {
-                value = std::move(values[0]);
+                value = std::move(arguments[0]);
             }
+
+            arguments.clear();
         }
 
         value.src = {src.data() + edge.start, src.data() + edge.end};
         return value;
     };
 
-    return iterate(iterate);
+    // The edges whose children are being evaluated, the tree has each edge before its children
+    struct Pending
+    {
+        const Edge<ParserTypes>* edge;
+        std::size_t evaluated;
+        std::size_t first;
+    };
+
+    std::vector<Pending> pending;
+
+    for (std::size_t index = 0;; index++)
+    {
+        const auto& edge = tree[index];
+        if (edge.rule && !edge.rule->symbols.empty())
+        {
+            pending.push_back({&edge, 0, values.size()});
+            continue;
+        }
+
+        // An edge without children is evaluated right away, and with it each parent it's the last child of
+        auto value = evaluate(edge, values.size());
+        while (!pending.empty())
+        {
+            auto& parent = pending.back();
+            if (!parent.edge->rule->isDiscarded(parent.evaluated))
+            {
+                values.push_back(std::move(value));
+            }
+
+            if (++parent.evaluated < parent.edge->rule->symbols.size())
+            {
+                break;
+            }
+
+            value = evaluate(*parent.edge, parent.first);
+            pending.pop_back();
+        }
+
+        if (pending.empty())
+        {
+            return value;
+        }
+    }
 }
 
 } // namespace larley
\ No newline at end of file
@@ -1,7 +1,11 @@
 #pragma once
 
-#include <vector>
+#include <algorithm>
 #include <deque>
+#include <span>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include "parsing-chart.hpp"
 
@@ -22,116 +26,753 @@ namespace larley
     using ParseTree = std::vector<Edge<ParserTypes>>;
 
     template <typename ParserTypes>
-    static ParseTree<ParserTypes> parseTree(const Grammar<ParserTypes>& grammar, const typename ParserTypes::Matcher matcher, const ParseChart<ParserTypes>& chart, typename ParserTypes::Src src)
+    static ParseTree<ParserTypes> parseTree(const Grammar<ParserTypes>& grammar, const typename ParserTypes::Matcher& matcher, const ParseChart<ParserTypes>& chart, typename ParserTypes::Src src);
+
+namespace impl
+{
+    // The span of a terminal standing for a non-terminal is parsed again on its own, its tree takes the terminal's place
+    template <typename ParserTypes>
+    void expandLeaf(const typename Grammar<ParserTypes>::Expansion& expansion, const typename ParserTypes::Matcher& matcher, const Edge<ParserTypes>& leaf, typename ParserTypes::Src src, ChartMode mode, ParseTree<ParserTypes>& tree)
+    {
+        const typename ParserTypes::Src span{src.data() + leaf.start, leaf.end - leaf.start};
+
+        const auto spanChart = parseChart(*expansion.grammar, matcher, span, {}, mode, expansion.start);
+        if (spanChart.matchCount == 0 || !spanChart.completeMatch)
+        {
+            tree.push_back(leaf);
+            return;
+        }
+
+        for (auto subEdge : parseTree(*expansion.grammar, matcher, spanChart, span))
+        {
+            subEdge.start += leaf.start;
+            subEdge.end += leaf.start;
+            tree.push_back(subEdge);
+        }
+    }
+
+    // Walks the parse forest down from its root, of the ways a node is derived it takes the one chartTree takes
+    // The children are picked from the first one on, the earliest rule in the grammar then the longest span among those a whole
+    // derivation of the node goes through, which the forest only has
+    template <typename ParserTypes>
+    ParseTree<ParserTypes> forestTree(const Grammar<ParserTypes>& grammar, const typename ParserTypes::Matcher& matcher, const ParseChart<ParserTypes>& chart, typename ParserTypes::Src src)
+    {
+        using Forest = ParseForest<ParserTypes>;
+        constexpr auto noNode = Forest::noNode;
+
+        const auto& forest = chart.forest;
+
+        // The complete dotted rule of the first rule deriving a symbol node, dotted rules are numbered in the order of the rules
+        const auto firstRule = [&](std::uint32_t node)
+        {
+            auto first = noNode;
+            for (auto id = forest.nodes[node].firstPacked; id != noNode; id = forest.packed[id].next)
+            {
+                if (forest.packed[id].left != Forest::pendingChain)
+                {
+                    first = std::min(first, forest.packed[id].dottedRule);
+                }
+            }
+
+            return first;
+        };
+
+        const auto preferred = [&](std::uint32_t node, std::uint32_t other)
+        {
+            const auto rule = firstRule(node);
+            const auto otherRule = firstRule(other);
+            return rule != otherRule ? rule < otherRule : forest.nodes[node].end > forest.nodes[other].end;
+        };
+
+        // Packed nodes reached from the node being split, by how many symbols their node covers, from all of them down to two
+        struct Link
+        {
+            std::uint32_t parent;
+            std::uint32_t left;
+            std::uint32_t right;
+        };
+
+        std::vector<Link> links;
+        std::vector<std::size_t> levelStarts;
+        std::vector<std::uint32_t> level;
+        std::vector<std::uint32_t> nextLevel;
+        std::vector<std::uint32_t> reached(forest.nodes.size());
+        std::uint32_t stamp{};
+
+        // The chosen node of each symbol of the node being split
+        std::vector<std::uint32_t> children;
+
+        const auto split = [&](std::uint32_t node, std::uint32_t dottedRule)
+        {
+            const auto symbolCount = grammar.getDot(dottedRule);
+            children.assign(symbolCount, noNode);
+            if (symbolCount == 0)
+            {
+                return;
+            }
+
+            links.clear();
+            levelStarts.clear();
+            level.assign(1, node);
+            for (auto covered = symbolCount;; covered--)
+            {
+                levelStarts.push_back(links.size());
+                nextLevel.clear();
+                stamp++;
+
+                for (const auto parent : level)
+                {
+                    for (auto id = forest.nodes[parent].firstPacked; id != noNode; id = forest.packed[id].next)
+                    {
+                        const auto& packed = forest.packed[id];
+                        if (packed.left == Forest::pendingChain || (parent == node && packed.dottedRule != dottedRule))
+                        {
+                            continue;
+                        }
+
+                        links.push_back({parent, packed.left, packed.right});
+                        if (covered > 2 && reached[packed.left] != stamp)
+                        {
+                            reached[packed.left] = stamp;
+                            nextLevel.push_back(packed.left);
+                        }
+                    }
+                }
+
+                if (covered <= 2)
+                {
+                    break;
+                }
+
+                std::swap(level, nextLevel);
+            }
+
+            levelStarts.push_back(links.size());
+
+            const auto levelLinks = [&](std::size_t covered)
+            {
+                const auto index = symbolCount - covered;
+                return std::span{links.begin() + levelStarts[index], links.begin() + levelStarts[index + 1]};
+            };
+
+            // The first symbol's node is the left one of the lowest level, unless it's the only symbol
+            auto chosen = noNode;
+            for (const auto& link : levelLinks(std::min<std::size_t>(symbolCount, 2)))
+            {
+                const auto first = symbolCount == 1 ? link.right : link.left;
+                if (chosen == noNode || preferred(first, chosen))
+                {
+                    chosen = first;
+                }
+            }
+
+            children[0] = chosen;
+            for (std::size_t x = 1; x < symbolCount; x++)
+            {
+                const Link* best{};
+                for (const auto& link : levelLinks(x + 1))
+                {
+                    if (link.left == chosen && (!best || preferred(link.right, best->right)))
+                    {
+                        best = &link;
+                    }
+                }
+
+                children[x] = best->right;
+                chosen = best->parent;
+            }
+        };
+
+        ParseTree<ParserTypes> tree;
+
+        // Nodes left to walk, the next one on top, with the rule taken for a symbol node and the dotted rule before a terminal
+        struct Pending
+        {
+            std::uint32_t node;
+            std::uint32_t dottedRule;
+        };
+
+        std::vector<Pending> pending{{forest.root, firstRule(forest.root)}};
+        while (!pending.empty())
+        {
+            const auto [node, dottedRule] = pending.back();
+            pending.pop_back();
+
+            const auto& treeNode = forest.nodes[node];
+            if (forest.isTerminal(node))
+            {
+                const Edge<ParserTypes> leaf{chart.terminalStart(treeNode.start), treeNode.end};
+                if (dottedRule < grammar.expansions.size() && grammar.expansions[dottedRule])
+                {
+                    expandLeaf(*grammar.expansions[dottedRule], matcher, leaf, src, chart.mode, tree);
+                }
+                else
+                {
+                    tree.push_back(leaf);
+                }
+
+                continue;
+            }
+
+            // Completed items start before the input skipped at their position, a non-empty edge starts at its first terminal
+            const auto& rule = grammar.getRule(dottedRule);
+            tree.push_back({treeNode.end > treeNode.start ? chart.terminalStart(treeNode.start) : treeNode.start, treeNode.end, &rule});
+
+            split(node, dottedRule);
+            const auto firstDottedRule = grammar.ruleToDottedRule[rule.id];
+            for (auto x = children.size(); x > 0; x--)
+            {
+                const auto child = children[x - 1];
+                pending.push_back({child, forest.isTerminal(child) ? firstDottedRule + static_cast<std::uint32_t>(x - 1) : firstRule(child)});
+            }
+        }
+
+        return tree;
+    }
+
+    // Follows the back-pointers down from the complete start item, parseChart kept the derivation chartTree takes for each item
+    template <typename ParserTypes>
+    ParseTree<ParserTypes> backPointerTree(const Grammar<ParserTypes>& grammar, const typename ParserTypes::Matcher& matcher, const ParseChart<ParserTypes>& chart, typename ParserTypes::Src src)
+    {
+        using BackPointerT = BackPointer<ParserTypes>;
+        using Origin = ParserTypes::Origin;
+
+        constexpr auto noIndex = std::numeric_limits<std::uint32_t>::max();
+
+        const auto& S = chart.S;
+        const auto emptyRules = impl::emptyRules(grammar);
+
+        // The links of Leo's chains the walk went through, the chart skipped them
+        // The child of a link is the link below it in this list, or the item completed into the chain for the first one
+        struct ChainLink
+        {
+            std::uint32_t dottedRule;
+            std::size_t start;
+            BackPointerT backPointer;
+        };
+
+        std::vector<ChainLink> links;
+
+        // Climbs the chain from the item completed into it up to `top`, returns the index of the link below it if there's one
+        const auto climb = [&](std::size_t setIndex, std::uint32_t completed, const Item<ParserTypes>& top)
+        {
+            auto below = noIndex;
+            const auto& item = S[setIndex][completed];
+            auto start = static_cast<std::size_t>(item.start);
+            auto symbol = grammar.getRule(item.dottedRule).product;
+
+            while (true)
+            {
+                const auto& transitive = *S[start].transitives.find(symbol)->second;
+                const auto link = transitive.penultimate.advanced();
+                if (link == top)
+                {
+                    return below;
+                }
+
+                const auto child = below == noIndex ? completed : below | BackPointerT::leoChain;
+                links.push_back({link.dottedRule, link.start, {static_cast<Origin>(start), transitive.penultimateIndex, child}});
+                below = static_cast<std::uint32_t>(links.size() - 1);
+
+                start = link.start;
+                symbol = grammar.getRule(link.dottedRule).product;
+            }
+        };
+
+        // The first rule of the start symbol that matched, like chartTree
+        const auto last = S.size() - 1;
+        auto rootIndex = noIndex;
+        for (std::size_t itemIndex = 0; itemIndex < S[last].size(); itemIndex++)
+        {
+            const auto& item = S[last][itemIndex];
+            if (item.start == 0 && grammar.isComplete(item.dottedRule) && grammar.getRule(item.dottedRule).product == chart.rootSymbol(grammar) &&
+                (rootIndex == noIndex || item.dottedRule < S[last][rootIndex].dottedRule))
+            {
+                rootIndex = static_cast<std::uint32_t>(itemIndex);
+            }
+        }
+
+        ParseTree<ParserTypes> tree;
+
+        // Items left to walk, the next one on top, with their back-pointer, for a link its child is in `links`
+        // A terminal is kept as the dotted rule before it in its parent and its span
+        struct Pending
+        {
+            std::size_t set;
+            std::uint32_t dottedRule;
+            std::size_t start;
+            BackPointerT backPointer;
+            bool terminal;
+            bool link;
+        };
+
+        const auto& rootItem = S[last][rootIndex];
+        std::vector<Pending> pending{{last, rootItem.dottedRule, 0, S[last].backPointers[rootIndex], false, false}};
+        while (!pending.empty())
+        {
+            const auto [set, dottedRule, start, backPointer, terminal, link] = pending.back();
+            pending.pop_back();
+
+            if (terminal)
+            {
+                const Edge<ParserTypes> leaf{chart.terminalStart(start), set};
+                if (dottedRule < grammar.expansions.size() && grammar.expansions[dottedRule])
+                {
+                    expandLeaf(*grammar.expansions[dottedRule], matcher, leaf, src, chart.mode, tree);
+                }
+                else
+                {
+                    tree.push_back(leaf);
+                }
+
+                continue;
+            }
+
+            const auto& rule = grammar.getRule(dottedRule);
+            const auto firstDottedRule = grammar.ruleToDottedRule[rule.id];
+
+            // The symbols of an item spanning nothing all derive the empty string with their first rule that can
+            if (start == set)
+            {
+                tree.push_back({set, set, &rule});
+                for (auto x = rule.symbols.size(); x > 0; x--)
+                {
+                    pending.push_back({set, emptyRules[grammar.postdotProductIds[firstDottedRule + x - 1]], set, {}, false, false});
+                }
+
+                continue;
+            }
+
+            // Completed items start before the input skipped at their position, a non-empty edge starts at its first terminal
+            tree.push_back({chart.terminalStart(start), set, &rule});
+
+            // Back-pointers go from the last child to the first one, the order they're walked in once pushed
+            // Only the last child can be a link of a chain
+            auto childDottedRule = dottedRule;
+            auto childBackPointer = backPointer;
+            auto end = set;
+            for (auto x = rule.symbols.size(); x > 0; x--, childDottedRule--)
+            {
+                if (start == end)
+                {
+                    pending.push_back({end, emptyRules[grammar.postdotProductIds[childDottedRule - 1]], end, {}, false, false});
+                    continue;
+                }
+
+                const auto& endSet = S[end];
+                const auto child = childBackPointer.child;
+                if (child == BackPointerT::terminal)
+                {
+                    pending.push_back({end, childDottedRule - 1, childBackPointer.split, {}, true, false});
+                }
+                else if (child == BackPointerT::empty)
+                {
+                    pending.push_back({end, emptyRules[grammar.postdotProductIds[childDottedRule - 1]], end, {}, false, false});
+                }
+                else if (child & BackPointerT::leoChain)
+                {
+                    // A link's child is the link below it, a top's is found by climbing its chain from the item completed into it
+                    auto below = child;
+                    if (!link)
+                    {
+                        const auto completed = child & ~BackPointerT::leoChain;
+                        below = climb(end, completed, {dottedRule, static_cast<Origin>(start)});
+                        below = below == noIndex ? completed : below | BackPointerT::leoChain;
+                    }
+
+                    if (below & BackPointerT::leoChain)
+                    {
+                        const auto& chainLink = links[below & ~BackPointerT::leoChain];
+                        pending.push_back({end, chainLink.dottedRule, chainLink.start, chainLink.backPointer, false, true});
+                    }
+                    else
+                    {
+                        pending.push_back({end, endSet[below].dottedRule, childBackPointer.split, endSet.backPointers[below], false, false});
+                    }
+                }
+                else
+                {
+                    pending.push_back({end, endSet[child].dottedRule, childBackPointer.split, endSet.backPointers[child], false, false});
+                }
+
+                end = childBackPointer.split;
+                if (start < end)
+                {
+                    childBackPointer = S[end].backPointers[childBackPointer.predecessor];
+                }
+            }
+        }
+
+        return tree;
+    }
+
+    // Finds the children of each edge again in the completed items of the chart, for the charts that only have the items
+    template <typename ParserTypes>
+    ParseTree<ParserTypes> chartTree(const Grammar<ParserTypes>& grammar, const typename ParserTypes::Matcher& matcher, const ParseChart<ParserTypes>& chart, typename ParserTypes::Src src)
     {
         const auto& S = chart.S;
 
-        using EdgeSet = std::vector<Edge<ParserTypes>>;
-        std::vector<EdgeSet> rchart(S.size());
+        using RuleT = Rule<ParserTypes>;
+
+        // Ends of the completed items of each non-terminal by their start, for each of its rules in the grammar's order,
+        // the one the tree takes them in. The sets are read in order so the ends are increasing
+        struct CompletedRule
+        {
+            const RuleT* rule;
+            std::vector<std::size_t> ends;
+        };
+
+        std::unordered_map<std::size_t, std::vector<CompletedRule>> completed;
+        completed.reserve(S.size());
+        const auto key = [&](std::size_t start, std::uint32_t productId) { return start * grammar.productCount + productId; };
 
         for (std::size_t stateIndex = 0; stateIndex < S.size(); stateIndex++)
         {
-            for (std::size_t itemIndex = 0; itemIndex < S[stateIndex].size(); itemIndex++)
+            for (const auto& item : S[stateIndex])
             {
-                const auto& item = S[stateIndex][itemIndex];
-                if (!item.isComplete())
+                if (!grammar.isComplete(item.dottedRule))
                 {
                     continue;
                 }
 
-                rchart[item.start].emplace_back(item.start, stateIndex, &item.rule);
+                const auto* rule = &grammar.getRule(item.dottedRule);
+                auto& rules = completed[key(item.start, grammar.productIds[rule->id])];
+                auto it = std::ranges::lower_bound(rules, rule, {}, &CompletedRule::rule);
+                if (it == rules.end() || it->rule != rule)
+                {
+                    it = rules.insert(it, {rule, {}});
+                }
+
+                it->ends.push_back(stateIndex);
             }
         }
 
-        for (auto& edgeSet : rchart)
+        const auto completedRules = [&](std::size_t start, std::uint32_t productId) -> std::span<const CompletedRule>
         {
-            std::ranges::sort(edgeSet, [](auto& edge1, auto& edge2)
+            const auto it = completed.find(key(start, productId));
+            return it == completed.end() ? std::span<const CompletedRule>{} : std::span<const CompletedRule>{it->second};
+        };
+
+        // The first rule of the non-terminal with a completed item from start to end
+        const auto completedRule = [&](std::size_t start, std::uint32_t productId, std::size_t end) -> const RuleT*
+        {
+            for (const auto& [rule, ends] : completedRules(start, productId))
             {
-                if (edge2.rule && edge1.rule == edge2.rule)
+                if (std::ranges::binary_search(ends, end))
                 {
-                    return edge1.end > edge2.end;
+                    return rule;
                 }
+            }
 
-                return edge1.rule < edge2.rule; 
-            });
+            return nullptr;
+        };
+
+        // Completed edges skipped by Leo's transitive items are restored on demand
+        // They can only be the last child of the next link of their chain, so they always end where their parent ends
+        struct TransitiveLink
+        {
+            std::size_t id;
+            std::size_t setIndex;
+            std::uint32_t productId;
+            const RuleT* rule;
+        };
+
+        std::vector<std::vector<TransitiveLink>> links(S.size());
+        std::size_t linkCount{};
+        for (std::size_t stateIndex = 0; stateIndex < S.size(); stateIndex++)
+        {
+            for (const auto& [_, transitive] : S[stateIndex].transitives)
+            {
+                // The topmost item of a chain is in the chart already
+                if (!transitive || transitive->top == transitive->penultimate.advanced())
+                {
+                    continue;
+                }
+
+                const auto& penultimate = transitive->penultimate;
+                links[penultimate.start].emplace_back(linkCount++, stateIndex, grammar.postdotProductIds[penultimate.dottedRule], &grammar.getRule(penultimate.dottedRule));
+            }
         }
 
+        std::vector<std::vector<Edge<ParserTypes>>> restored(S.size());
+        std::unordered_set<std::size_t> visitedLinks;
+
+        // The first restored rule of the non-terminal from start to end
+        const auto restoredRule = [&](std::size_t start, std::uint32_t productId, std::size_t end)
+        {
+            const RuleT* best{};
+            for (const auto& edge : restored[start])
+            {
+                if (grammar.productIds[edge.rule->id] == productId && edge.end == end && (!best || edge.rule < best))
+                {
+                    best = edge.rule;
+                }
+            }
+
+            return best;
+        };
+
+        // The links being walked down, the chain below the one before `next` was walked if `walked`
+        struct Restoring
+        {
+            std::size_t start;
+            std::uint32_t productId;
+            std::size_t next;
+            bool walked;
+        };
+
+        std::vector<Restoring> restoring;
+
+        // The penultimate item of a link completes at `end` if the symbol it waits on completes there too, which is known once
+        // the links below it are restored
+        const auto restoreTransitives = [&](std::size_t start, std::uint32_t productId, std::size_t end)
+        {
+            restoring.assign(1, {start, productId, 0, false});
+            while (!restoring.empty())
+            {
+                auto& frame = restoring.back();
+                const auto& frameLinks = links[frame.start];
+                if (frame.walked)
+                {
+                    frame.walked = false;
+                    const auto& link = frameLinks[frame.next - 1];
+                    if (completedRule(link.setIndex, link.productId, end) || restoredRule(link.setIndex, link.productId, end))
+                    {
+                        restored[frame.start].emplace_back(frame.start, end, link.rule);
+                    }
+                }
+
+                if (frame.next == frameLinks.size())
+                {
+                    restoring.pop_back();
+                    continue;
+                }
+
+                const auto& link = frameLinks[frame.next++];
+                if (grammar.productIds[link.rule->id] != frame.productId || link.setIndex >= end || !visitedLinks.insert(link.id * S.size() + end).second)
+                {
+                    continue;
+                }
+
+                frame.walked = true;
+                restoring.push_back({link.setIndex, link.productId, 0, false});
+            }
+        };
+
+        // Terminals are looked up in the lengths parseChart memoized, the matcher is only called for the ones it never tried
+        const auto match = [&](std::size_t position, std::uint32_t dottedRule, const typename ParserTypes::Terminal& terminal)
+        {
+            if (const auto matchLength = chart.findMatch(position, grammar.terminalIds[dottedRule]))
+            {
+                chart.matchStats.hits++;
+                return *matchLength;
+            }
+
+            chart.matchStats.misses++;
+            return matcher(src, chart.terminalStart(position), terminal);
+        };
+
+        // The children splitEdge found for the edge it was given
         std::vector<Edge<ParserTypes>> result;
+
+        // The candidates left for each child splitEdge went down to, the next one is the `end`th end of the `rule`th completed
+        // rule counting down, `fresh` until the child's first one is tried
+        struct Choice
+        {
+            std::size_t start;
+            std::span<const CompletedRule> rules;
+            std::size_t rule;
+            std::size_t end;
+            bool fresh;
+        };
+
+        std::vector<Choice> choices;
+
+        // Backtracks over the children from the first one, keeping the first candidates that lead to the edge's end
         const auto splitEdge = [&](const Edge<ParserTypes>& edge)
         {
             const auto& symbols = edge.rule->symbols;
             const auto symbolCount = symbols.size();
             result.resize(symbolCount);
 
-            const auto iter = [&](this auto const& iter, std::size_t depth, std::size_t start)
+            choices.assign(1, {edge.start, {}, 0, 0, true});
+            while (!choices.empty())
             {
-                if (depth == symbolCount && start == edge.end)
+                const auto depth = choices.size() - 1;
+                auto& choice = choices.back();
+                const auto start = choice.start;
+                if (depth == symbolCount)
                 {
-                    return true;
-                }
+                    if (start == edge.end)
+                    {
+                        return;
+                    }
 
-                if (depth >= symbolCount)
-                {
-                    return false;
+                    choices.pop_back();
+                    continue;
                 }
 
+                const auto fresh = choice.fresh;
+                choice.fresh = false;
+
                 const auto& symbol = symbols[depth];
-                if (auto* nt = std::get_if<0>(&symbol))
+                if (std::holds_alternative<typename ParserTypes::NonTerminal>(symbol))
                 {
-                    for (const auto& item : rchart[start])
+                    const auto productId = grammar.postdotProductIds[grammar.ruleToDottedRule[edge.rule->id] + depth];
+                    if (depth + 1 == symbolCount)
                     {
-                        if (item.rule->product == *nt && iter(depth + 1, item.end))
+                        if (!fresh)
+                        {
+                            choices.pop_back();
+                            continue;
+                        }
+
+                        // The last child has to end where the edge ends, it's also the only place a restored edge can appear
+                        restoreTransitives(start, productId, edge.end);
+
+                        const auto* best = completedRule(start, productId, edge.end);
+                        if (const auto* restoredBest = restoredRule(start, productId, edge.end); restoredBest && (!best || restoredBest < best))
                         {
-                            result[depth] = item;
-                            return true;
+                            best = restoredBest;
                         }
+
+                        if (best)
+                        {
+                            result[depth] = {start, edge.end, best};
+                            return;
+                        }
+
+                        choices.pop_back();
+                        continue;
                     }
-                }
-                else if (auto* lt = std::get_if<1>(&symbol))
-                {
-                    const auto matchLength = matcher(src, start, *lt);
-                    if (matchLength > 0)
+
+                    // A child can't end after its parent, each rule's ends are tried from the longest one
+                    const auto firstEnd = [&](const CompletedRule& rule)
                     {
-                        if (iter(depth + 1, start + matchLength))
+                        return static_cast<std::size_t>(std::ranges::upper_bound(rule.ends, edge.end) - rule.ends.begin());
+                    };
+
+                    if (fresh)
+                    {
+                        choice.rules = completedRules(start, productId);
+                        choice.end = choice.rules.empty() ? 0 : firstEnd(choice.rules.front());
+                    }
+
+                    while (choice.end == 0 && choice.rule < choice.rules.size())
+                    {
+                        if (++choice.rule < choice.rules.size())
                         {
-                            result[depth] = {start, start + matchLength};
-                            return true;
+                            choice.end = firstEnd(choice.rules[choice.rule]);
                         }
                     }
-                }
 
-                return false;
-            };
+                    if (choice.rule == choice.rules.size())
+                    {
+                        choices.pop_back();
+                        continue;
+                    }
 
-            iter(0, edge.start);
+                    const auto& [rule, ruleEnds] = choice.rules[choice.rule];
+                    const auto end = ruleEnds[--choice.end];
+                    result[depth] = {start, end, rule};
+                    choices.push_back({end, {}, 0, 0, true});
+                }
+                else if (auto* lt = std::get_if<1>(&symbol); lt && fresh)
+                {
+                    const auto terminalStart = chart.terminalStart(start);
+                    const auto matchLength = match(start, grammar.ruleToDottedRule[edge.rule->id] + static_cast<std::uint32_t>(depth), *lt);
+                    if (matchLength > 0)
+                    {
+                        result[depth] = {terminalStart, terminalStart + matchLength};
+                        choices.push_back({terminalStart + matchLength, {}, 0, 0, true});
+                        continue;
+                    }
 
-            return result;
+                    choices.pop_back();
+                }
+                else
+                {
+                    choices.pop_back();
+                }
+            }
         };
 
         ParseTree<ParserTypes> tree;
 
-        const auto iter = [&](this auto const& iter, const Edge<ParserTypes>& edge) -> void
+        // Edges left to walk, the next one on top, with the dotted rule before a terminal in its parent
+        struct Pending
         {
-            tree.push_back(edge);
+            Edge<ParserTypes> edge;
+            std::uint32_t dottedRule;
+        };
+
+        std::vector<Pending> pending;
 
-            if (edge.rule)
+        const auto last = S.size() - 1;
+        for (const auto& rule : grammar.rules)
+        {
+            if (rule.product == chart.rootSymbol(grammar))
             {
-                for (const auto& subEdge : splitEdge(edge))
+                if (const auto* root = completedRule(0, grammar.productIds[rule.id], last))
                 {
-                    iter(subEdge);
+                    pending.push_back({{0, last, root}, 0});
                 }
+
+                break;
             }
-        };
+        }
 
-        for (const auto& edge : rchart[0])
+        while (!pending.empty())
         {
-            if (edge.start == 0 && edge.end == rchart.size() - 1 && edge.rule->product == grammar.startSymbol)
+            const auto [edge, dottedRule] = pending.back();
+            pending.pop_back();
+
+            if (!edge.rule)
             {
-                iter(edge);
-                break;
+                if (dottedRule < grammar.expansions.size() && grammar.expansions[dottedRule])
+                {
+                    expandLeaf(*grammar.expansions[dottedRule], matcher, edge, src, chart.mode, tree);
+                }
+                else
+                {
+                    tree.push_back(edge);
+                }
+
+                continue;
+            }
+
+            // Completed items start before the input skipped at their position, a non-empty edge starts at its first terminal
+            auto& treeEdge = tree.emplace_back(edge);
+            if (edge.end > edge.start)
+            {
+                treeEdge.start = chart.terminalStart(edge.start);
+            }
+
+            splitEdge(edge);
+            const auto firstDottedRule = grammar.ruleToDottedRule[edge.rule->id];
+            for (auto x = result.size(); x > 0; x--)
+            {
+                pending.push_back({result[x - 1], firstDottedRule + static_cast<std::uint32_t>(x - 1)});
             }
         }
 
         return tree;
     }
+}
+
+    template <typename ParserTypes>
+    static ParseTree<ParserTypes> parseTree(const Grammar<ParserTypes>& grammar, const typename ParserTypes::Matcher& matcher, const ParseChart<ParserTypes>& chart, typename ParserTypes::Src src)
+    {
+        if (chart.forest.root != ParseForest<ParserTypes>::noNode)
+        {
+            return impl::forestTree(grammar, matcher, chart, src);
+        }
+
+        if (chart.mode == ChartMode::BackPointers)
+        {
+            return impl::backPointerTree(grammar, matcher, chart, src);
+        }
+
+        return impl::chartTree(grammar, matcher, chart, src);
+    }
  }
\ No newline at end of file
@@ -1,8 +1,10 @@
 #pragma once
 
+#include <iomanip>
 #include <iostream>
 #include <functional>
 #include <variant>
+#include <vector>
 
 #include "utils.hpp"
 
@@ -28,12 +30,22 @@ void printTree(const auto& grammar, const auto& tree, const auto& src)
 
     const auto maximumNonTerminalLength = findMaximumNonTerminalLenght(grammar);
 
-    std::size_t index = 0;
-    const auto iter = [&](this const auto& iter, std::size_t depth = 0) -> void
+    // The number of children left to print of each edge being printed, the tree has each edge before its children
+    std::vector<std::size_t> remaining;
+    for (const auto& edge : tree)
     {
-        const auto& edge = tree[index++];
+        while (!remaining.empty() && remaining.back() == 0)
+        {
+            remaining.pop_back();
+        }
+
+        const auto depth = remaining.size();
+        if (!remaining.empty())
+        {
+            remaining.back()--;
+        }
 
-        for (int x = 0; x < depth; x++)
+        for (std::size_t x = 0; x < depth; x++)
         {
             std::cout << "  ";
         }
@@ -41,11 +53,7 @@ void printTree(const auto& grammar, const auto& tree, const auto& src)
         if (edge.rule)
         {
             std::cout << edge.rule->product <<  " ( " << edge.start << ", " << edge.end << ")\n";
-
-            for (int x = 0; x < edge.rule->symbols.size(); x++)
-            {
-                iter(depth + 1);
-            }
+            remaining.push_back(edge.rule->symbols.size());
         }
         else
         {
@@ -53,9 +61,7 @@ void printTree(const auto& grammar, const auto& tree, const auto& src)
             printUnescaped({src.data() + edge.start, src.data() + edge.end});
             std::cout << "\" ( " << edge.start << ", " << edge.end << ")\n";
         }
-    };
-
-    iter();
+    }
 
     std::cout << std::endl << std::endl;
 }
@@ -106,14 +112,15 @@ void printError(const auto& grammar, const auto& parserError, const auto& src)
         for (const auto itemPtr : prediction.path)
         {
             const auto& item = *itemPtr;
-            const auto& rule = item.rule;
+            const auto& rule = grammar.getRule(item.dottedRule);
+            const auto dot = grammar.getDot(item.dottedRule);
             std::cout << "    " << std::setw(maximumNonTerminalLength) << rule.product << " ->";
 
             for (std::size_t z = 0; z < rule.symbols.size(); z++)
             {
                 const auto& symbol = rule.symbols[z];
 
-                if (item.dot == z)
+                if (dot == z)
                 {
                     std::print("\u2022");
                 }
@@ -182,14 +189,15 @@ void printChart(const auto& grammar, const auto& chart)
         for (std::size_t y = 0; y < set.size(); y++)
         {
             const auto& item = set[y];
-            const auto& rule = item.rule;
+            const auto& rule = grammar.getRule(item.dottedRule);
+            const auto dot = grammar.getDot(item.dottedRule);
             std::cout << std::setw(maximumNonTerminalLength) << rule.product << " ->";
 
             for (std::size_t z = 0; z < rule.symbols.size(); z++)
             {
                 const auto& symbol = rule.symbols[z];
 
-                if (item.dot == z)
+                if (dot == z)
                 {
                     std::print("\u2022");
                 }
@@ -208,7 +216,7 @@ void printChart(const auto& grammar, const auto& chart)
                 }
             }
 
-            if (item.dot == rule.symbols.size())
+            if (dot == rule.symbols.size())
             {
                 std::print("\u2022");
             }
@@ -0,0 +1,946 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bitset>
+#include <cassert>
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "simd.hpp"
+
+namespace larley
+{
+
+// Anchored regex matcher, a Thompson NFA whose DFA states are built the first time a walk needs them
+// It supports the ECMAScript subset grammars use: classes, escapes, groups, alternation and greedy quantifiers
+// Matches are the longest ones, several patterns can be added with their own tag and are all matched by a single walk
+// Once compiled an automaton can be shared by parsers running on different threads, the states they build are published under a lock
+class RegexAutomaton
+{
+  public:
+    using Bytes = std::bitset<256>;
+
+    // Returns false and leaves the automaton unchanged if the pattern uses syntax this engine doesn't support
+    bool add(std::string_view pattern, std::uint32_t tag)
+    {
+        const auto nfaSize = nfa.size();
+
+        PatternParser parser{*this, pattern};
+        const auto fragment = parser.parse();
+        if (!fragment)
+        {
+            nfa.resize(nfaSize);
+            return false;
+        }
+
+        accept(*fragment, tag);
+        return true;
+    }
+
+    // The bytes of a bracket class body like "0-9a-f", "^\"\\" or "\\w-", nullopt if it isn't one this engine supports
+    static std::optional<Bytes> parseClass(std::string_view spec)
+    {
+        const auto pattern = std::string(spec) + "]";
+
+        RegexAutomaton automaton;
+        PatternParser parser{automaton, pattern};
+        const auto bytes = parser.bracketBytes();
+        if (!bytes || parser.index != pattern.size())
+        {
+            return {};
+        }
+
+        return bytes;
+    }
+
+    // Sets up the DFA's start state, to call once the patterns are added and before matching, adding a pattern drops the DFA
+    // The other states are built by the walks that reach them, up to maxDfaStates, past it the walks step through the NFA instead
+    void compile()
+    {
+        cache = std::make_unique<DfaCache>();
+        cache->start = addDfaState(closure(starts));
+    }
+
+    // Calls `onAccept(tags, length)` for the lengths some patterns match at `index`, by increasing length
+    // Each pattern's longest match is reported, but a run of bytes looping on the same state, like in [^"]*, is skipped
+    // at once with simd::skipRun and only its end is
+    void walk(std::string_view src, std::size_t index, const auto& onAccept) const
+    {
+        assert(cache && "the automaton isn't compiled");
+
+        auto* current = cache->states[cache->start].get();
+        for (auto position = index;; position++)
+        {
+            if (!current->tags.empty())
+            {
+                onAccept(std::span<const std::uint32_t>(current->tags), position - index);
+            }
+
+            if (position >= src.size())
+            {
+                return;
+            }
+
+            if (current->run)
+            {
+                if (const auto end = simd::skipRun(src, position, *current->run); end > position)
+                {
+                    position = end - 1;
+                    continue;
+                }
+            }
+
+            const auto byte = static_cast<unsigned char>(src[position]);
+
+            auto next = current->next[byte].load(std::memory_order_acquire);
+            if (next == unknown)
+            {
+                next = transition(*current, byte);
+            }
+
+            if (next == dead)
+            {
+                return;
+            }
+
+            if (next == unknown)
+            {
+                walkNfa(src, index, position, current->nfaStates, onAccept);
+                return;
+            }
+
+            current = cache->states[next].get();
+        }
+    }
+
+    // Length of the longest match at `index`, -1 if there is none
+    int match(std::string_view src, std::size_t index) const
+    {
+        int length = -1;
+        walk(src, index, [&](std::span<const std::uint32_t>, std::size_t matched) { length = static_cast<int>(matched); });
+        return length;
+    }
+
+    // Bytes the transitions out of the start state consume, the ones a non-empty match can start with
+    Bytes firstBytes() const
+    {
+        Bytes bytes;
+        for (const auto state : closure(starts))
+        {
+            if (nfa[state].consumes)
+            {
+                bytes |= nfa[state].bytes;
+            }
+        }
+
+        return bytes;
+    }
+
+    // Bytes that can extend a match into a longer one, none if no match is a prefix of another
+    // It goes through every DFA state without adding them to the cache, nullopt if there are more than maxDfaStates
+    std::optional<Bytes> extendingBytes() const
+    {
+        Bytes bytes;
+
+        std::map<std::vector<std::uint32_t>, bool> seen;
+        std::vector<std::vector<std::uint32_t>> pending{closure(starts)};
+        seen.emplace(pending.back(), true);
+
+        while (!pending.empty())
+        {
+            const auto nfaStates = std::move(pending.back());
+            pending.pop_back();
+
+            const auto accepting = std::ranges::any_of(nfaStates, [&](std::uint32_t state) { return nfa[state].tag != none; });
+            for (std::size_t byte = 0; byte < bytes.size(); byte++)
+            {
+                auto next = targets(nfaStates, static_cast<unsigned char>(byte));
+                if (next.empty())
+                {
+                    continue;
+                }
+
+                if (accepting)
+                {
+                    bytes.set(byte);
+                }
+
+                next = closure(std::move(next));
+                if (seen.emplace(next, true).second)
+                {
+                    if (seen.size() > maxDfaStates)
+                    {
+                        return {};
+                    }
+
+                    pending.push_back(std::move(next));
+                }
+            }
+        }
+
+        return bytes;
+    }
+
+  private:
+    static constexpr std::uint32_t none = std::numeric_limits<std::uint32_t>::max();
+
+    struct NfaState
+    {
+        // Consuming states go to `next` on one of `bytes`, the others go to both `next` and `alt` without consuming anything
+        Bytes bytes;
+        bool consumes{};
+        std::uint32_t next = none;
+        std::uint32_t alt = none;
+
+        // Set on the final state of each pattern
+        std::uint32_t tag = none;
+    };
+
+    // Part of the NFA with a single entry and a single exit, the exit's `next` isn't set yet
+    struct Fragment
+    {
+        std::uint32_t start;
+        std::uint32_t end;
+    };
+
+    std::vector<NfaState> nfa;
+    std::vector<std::uint32_t> starts;
+
+    std::uint32_t newState(NfaState state)
+    {
+        nfa.push_back(state);
+        return static_cast<std::uint32_t>(nfa.size() - 1);
+    }
+
+    std::uint32_t newState()
+    {
+        return newState(NfaState{});
+    }
+
+    void accept(Fragment fragment, std::uint32_t tag)
+    {
+        const auto final = newState({.bytes = {}, .tag = tag});
+        nfa[fragment.end].next = final;
+        starts.push_back(fragment.start);
+
+        cache.reset();
+    }
+
+    Fragment empty()
+    {
+        const auto state = newState();
+        return {state, state};
+    }
+
+    Fragment byteClass(const Bytes& bytes)
+    {
+        const auto end = newState();
+        return {newState({bytes, true, end}), end};
+    }
+
+    Fragment concatenate(Fragment first, Fragment second)
+    {
+        nfa[first.end].next = second.start;
+        return {first.start, second.end};
+    }
+
+    Fragment alternate(Fragment first, Fragment second)
+    {
+        const auto end = newState();
+        nfa[first.end].next = end;
+        nfa[second.end].next = end;
+        return {newState({.bytes = {}, .next = first.start, .alt = second.start}), end};
+    }
+
+    Fragment star(Fragment body)
+    {
+        const auto end = newState();
+        const auto loop = newState({.bytes = {}, .next = body.start, .alt = end});
+        nfa[body.end].next = loop;
+        return {loop, end};
+    }
+
+    Fragment plus(Fragment body)
+    {
+        const auto end = newState();
+        const auto loop = newState({.bytes = {}, .next = body.start, .alt = end});
+        nfa[body.end].next = loop;
+        return {body.start, end};
+    }
+
+    Fragment optional(Fragment body)
+    {
+        const auto end = newState();
+        nfa[body.end].next = end;
+        return {newState({.bytes = {}, .next = body.start, .alt = end}), end};
+    }
+
+    // Recursive descent over the pattern, the fragments are added to the NFA as they're parsed
+    // Anything it doesn't know fails the whole pattern rather than guessing what ECMAScript would make of it
+    struct PatternParser
+    {
+        RegexAutomaton& automaton;
+        std::string_view pattern;
+        std::size_t index{};
+
+        std::optional<Fragment> parse()
+        {
+            const auto fragment = alternatives();
+            if (!fragment || index != pattern.size())
+            {
+                return {};
+            }
+
+            return fragment;
+        }
+
+        std::optional<Fragment> alternatives()
+        {
+            auto result = sequence();
+            while (result && index < pattern.size() && pattern[index] == '|')
+            {
+                index++;
+
+                const auto other = sequence();
+                if (!other)
+                {
+                    return {};
+                }
+
+                result = automaton.alternate(*result, *other);
+            }
+
+            return result;
+        }
+
+        std::optional<Fragment> sequence()
+        {
+            auto result = automaton.empty();
+            while (index < pattern.size() && pattern[index] != '|' && pattern[index] != ')')
+            {
+                const auto atomBegin = index;
+                const auto atom = this->atom();
+                if (!atom)
+                {
+                    return {};
+                }
+
+                const auto quantified = this->quantified(*atom, atomBegin);
+                if (!quantified)
+                {
+                    return {};
+                }
+
+                result = automaton.concatenate(result, *quantified);
+            }
+
+            return result;
+        }
+
+        std::optional<Fragment> quantified(Fragment atom, std::size_t atomBegin)
+        {
+            if (index >= pattern.size())
+            {
+                return atom;
+            }
+
+            std::optional<Fragment> result;
+            switch (pattern[index])
+            {
+                case '*':
+                    index++;
+                    result = automaton.star(atom);
+                    break;
+                case '+':
+                    index++;
+                    result = automaton.plus(atom);
+                    break;
+                case '?':
+                    index++;
+                    result = automaton.optional(atom);
+                    break;
+                case '{':
+                    result = repeated(atom, atomBegin);
+                    break;
+                default:
+                    return atom;
+            }
+
+            // Lazy quantifiers prefer shorter matches, which a longest match engine can't honor
+            if (index < pattern.size() && pattern[index] == '?')
+            {
+                return {};
+            }
+
+            return result;
+        }
+
+        // {n}, {n,} and {n,m}, the atom is parsed again for each copy
+        std::optional<Fragment> repeated(Fragment atom, std::size_t atomBegin)
+        {
+            constexpr std::size_t maxCount = 1000;
+
+            const auto close = pattern.find('}', index);
+            if (close == std::string_view::npos)
+            {
+                return {};
+            }
+
+            const auto parseCount = [](std::string_view digits) -> std::optional<std::size_t>
+            {
+                std::size_t count{};
+                const auto [end, error] = std::from_chars(digits.data(), digits.data() + digits.size(), count);
+                if (digits.empty() || error != std::errc{} || end != digits.data() + digits.size() || count > maxCount)
+                {
+                    return {};
+                }
+
+                return count;
+            };
+
+            const auto body = pattern.substr(index + 1, close - index - 1);
+            const auto comma = body.find(',');
+
+            const auto min = parseCount(body.substr(0, comma));
+            std::optional<std::size_t> max = min;
+            if (comma != std::string_view::npos)
+            {
+                max = body.size() == comma + 1 ? std::optional<std::size_t>{} : parseCount(body.substr(comma + 1));
+                if (body.size() != comma + 1 && !max)
+                {
+                    return {};
+                }
+            }
+
+            if (!min || (max && *max < *min))
+            {
+                return {};
+            }
+
+            const auto atomEnd = index;
+            index = close + 1;
+
+            bool atomUsed = false;
+            const auto copy = [&]
+            {
+                if (!atomUsed)
+                {
+                    atomUsed = true;
+                    return atom;
+                }
+
+                PatternParser again{automaton, pattern.substr(0, atomEnd), atomBegin};
+                return *again.atom();
+            };
+
+            auto result = automaton.empty();
+            for (std::size_t count = 0; count < *min; count++)
+            {
+                result = automaton.concatenate(result, copy());
+            }
+
+            if (!max)
+            {
+                return automaton.concatenate(result, automaton.star(copy()));
+            }
+
+            for (auto count = *min; count < *max; count++)
+            {
+                result = automaton.concatenate(result, automaton.optional(copy()));
+            }
+
+            return result;
+        }
+
+        std::optional<Fragment> atom()
+        {
+            const auto c = pattern[index++];
+            switch (c)
+            {
+                case '(':
+                {
+                    if (pattern.substr(index, 2) == "?:")
+                    {
+                        index += 2;
+                    }
+                    else if (index < pattern.size() && pattern[index] == '?')
+                    {
+                        // Lookaheads
+                        return {};
+                    }
+
+                    const auto group = alternatives();
+                    if (!group || index >= pattern.size() || pattern[index] != ')')
+                    {
+                        return {};
+                    }
+
+                    index++;
+                    return group;
+                }
+                case '[':
+                    return bracket();
+                case '.':
+                {
+                    Bytes bytes;
+                    bytes.set();
+                    bytes.reset('\n');
+                    bytes.reset('\r');
+                    return automaton.byteClass(bytes);
+                }
+                case '\\':
+                {
+                    Bytes bytes;
+                    if (!escape(bytes, false))
+                    {
+                        return {};
+                    }
+
+                    return automaton.byteClass(bytes);
+                }
+                // Anchors, quantifiers with nothing to repeat and stray closing brackets
+                case '^':
+                case '$':
+                case '*':
+                case '+':
+                case '?':
+                case '{':
+                case '}':
+                case ']':
+                    return {};
+                default:
+                {
+                    Bytes bytes;
+                    bytes.set(static_cast<unsigned char>(c));
+                    return automaton.byteClass(bytes);
+                }
+            }
+        }
+
+        std::optional<Fragment> bracket()
+        {
+            const auto bytes = bracketBytes();
+            if (!bytes)
+            {
+                return {};
+            }
+
+            return automaton.byteClass(*bytes);
+        }
+
+        // After the opening bracket, up to and including the closing one
+        std::optional<Bytes> bracketBytes()
+        {
+            Bytes bytes;
+
+            const bool negated = index < pattern.size() && pattern[index] == '^';
+            if (negated)
+            {
+                index++;
+            }
+
+            // [] and [^] are valid ECMAScript but std::regex may not agree
+            if (index < pattern.size() && pattern[index] == ']')
+            {
+                return {};
+            }
+
+            while (index < pattern.size() && pattern[index] != ']')
+            {
+                // Class names, collating elements and equivalence classes
+                if (pattern[index] == '[' && index + 1 < pattern.size() && (pattern[index + 1] == ':' || pattern[index + 1] == '.' || pattern[index + 1] == '='))
+                {
+                    return {};
+                }
+
+                Bytes low;
+                if (!bracketElement(low))
+                {
+                    return {};
+                }
+
+                if (index + 1 < pattern.size() && pattern[index] == '-' && pattern[index + 1] != ']')
+                {
+                    index++;
+
+                    Bytes high;
+                    if (!bracketElement(high) || low.count() != 1 || high.count() != 1)
+                    {
+                        return {};
+                    }
+
+                    const auto from = single(low);
+                    const auto to = single(high);
+                    if (from > to)
+                    {
+                        return {};
+                    }
+
+                    for (auto x = from; x <= to; x++)
+                    {
+                        bytes.set(x);
+                    }
+
+                    continue;
+                }
+
+                bytes |= low;
+            }
+
+            if (index >= pattern.size())
+            {
+                return {};
+            }
+
+            index++;
+
+            return negated ? ~bytes : bytes;
+        }
+
+        bool bracketElement(Bytes& bytes)
+        {
+            const auto c = pattern[index++];
+            if (c == '\\')
+            {
+                return escape(bytes, true);
+            }
+
+            bytes.set(static_cast<unsigned char>(c));
+            return true;
+        }
+
+        static std::size_t single(const Bytes& bytes)
+        {
+            std::size_t x = 0;
+            while (!bytes[x])
+            {
+                x++;
+            }
+
+            return x;
+        }
+
+        // The escape after a backslash, false for the ones this engine doesn't support like backreferences or \b outside brackets
+        bool escape(Bytes& bytes, bool inBracket)
+        {
+            if (index >= pattern.size())
+            {
+                return false;
+            }
+
+            const auto addClass = [&](auto predicate, bool negated)
+            {
+                for (std::size_t x = 0; x < bytes.size(); x++)
+                {
+                    if (static_cast<bool>(predicate(static_cast<int>(x))) != negated)
+                    {
+                        bytes.set(x);
+                    }
+                }
+
+                return true;
+            };
+
+            const auto isWord = [](int x) { return std::isalnum(x) || x == '_'; };
+            const auto isHex = [&](std::size_t position) { return position < pattern.size() && std::isxdigit(static_cast<unsigned char>(pattern[position])); };
+
+            const auto c = pattern[index++];
+            switch (c)
+            {
+                case 'd':
+                case 'D':
+                    return addClass([](int x) { return std::isdigit(x); }, c == 'D');
+                case 'w':
+                case 'W':
+                    return addClass(isWord, c == 'W');
+                case 's':
+                case 'S':
+                    return addClass([](int x) { return std::isspace(x); }, c == 'S');
+                case 'f':
+                    bytes.set('\f');
+                    return true;
+                case 'n':
+                    bytes.set('\n');
+                    return true;
+                case 'r':
+                    bytes.set('\r');
+                    return true;
+                case 't':
+                    bytes.set('\t');
+                    return true;
+                case 'v':
+                    bytes.set('\v');
+                    return true;
+                case 'b':
+                    if (!inBracket)
+                    {
+                        return false;
+                    }
+
+                    bytes.set('\b');
+                    return true;
+                case 'x':
+                {
+                    if (!isHex(index) || !isHex(index + 1))
+                    {
+                        return false;
+                    }
+
+                    unsigned value{};
+                    std::from_chars(pattern.data() + index, pattern.data() + index + 2, value, 16);
+                    index += 2;
+
+                    bytes.set(value);
+                    return true;
+                }
+                default:
+                    if (std::isalnum(static_cast<unsigned char>(c)))
+                    {
+                        return false;
+                    }
+
+                    bytes.set(static_cast<unsigned char>(c));
+                    return true;
+            }
+        }
+    };
+
+    static constexpr std::uint32_t unknown = none;
+    static constexpr std::uint32_t dead = none - 1;
+
+    // The cache stops growing past this, the walks step through the NFA from there
+    static constexpr std::size_t maxDfaStates = 1024;
+
+    struct DfaState
+    {
+        // Sorted, only the consuming and the final NFA states
+        std::vector<std::uint32_t> nfaStates;
+
+        // Patterns that match once this state is reached, sorted
+        std::vector<std::uint32_t> tags;
+
+        // unknown until a walk takes the transition, written under the cache's lock and read without it
+        std::array<std::atomic<std::uint32_t>, 256> next;
+
+        // Bytes looping on this state if they fit in a few ranges, a walk skips their runs with simd::skipRun
+        std::optional<simd::ByteRanges> run;
+    };
+
+    // The states built so far, they never move once added so the walks read them without the lock
+    // An id is only handed out by a transition stored after its state, with release and acquire
+    struct DfaCache
+    {
+        std::array<std::unique_ptr<DfaState>, maxDfaStates> states;
+        std::uint32_t start{};
+
+        // Guarded by mutex, like the states being added
+        std::map<std::vector<std::uint32_t>, std::uint32_t> ids;
+        std::uint32_t size{};
+        std::mutex mutex;
+    };
+
+    std::unique_ptr<DfaCache> cache;
+
+    // Visited marks of a closure, a stamp per closure so that they don't have to be cleared
+    struct ClosureScratch
+    {
+        std::vector<std::uint32_t> stack;
+        std::vector<std::uint32_t> visited;
+        std::uint32_t stamp{};
+    };
+
+    // Replaces `states` by their closure, sorted, without allocating once the scratch buffers are big enough
+    void closure(std::vector<std::uint32_t>& states, ClosureScratch& scratch) const
+    {
+        scratch.visited.resize(nfa.size());
+        if (++scratch.stamp == 0)
+        {
+            std::ranges::fill(scratch.visited, 0);
+            scratch.stamp = 1;
+        }
+
+        scratch.stack.assign(states.begin(), states.end());
+        states.clear();
+
+        while (!scratch.stack.empty())
+        {
+            const auto state = scratch.stack.back();
+            scratch.stack.pop_back();
+
+            if (state == none || scratch.visited[state] == scratch.stamp)
+            {
+                continue;
+            }
+
+            scratch.visited[state] = scratch.stamp;
+
+            const auto& nfaState = nfa[state];
+            if (nfaState.consumes || nfaState.tag != none)
+            {
+                states.push_back(state);
+            }
+
+            if (!nfaState.consumes)
+            {
+                scratch.stack.push_back(nfaState.alt);
+                scratch.stack.push_back(nfaState.next);
+            }
+        }
+
+        std::ranges::sort(states);
+    }
+
+    std::vector<std::uint32_t> closure(std::vector<std::uint32_t> states) const
+    {
+        ClosureScratch scratch;
+        closure(states, scratch);
+        return states;
+    }
+
+    // NFA states reached by consuming `byte` from `from`, before their closure
+    void targets(std::span<const std::uint32_t> from, unsigned char byte, std::vector<std::uint32_t>& result) const
+    {
+        result.clear();
+        for (const auto nfaState : from)
+        {
+            if (nfa[nfaState].consumes && nfa[nfaState].bytes[byte])
+            {
+                result.push_back(nfa[nfaState].next);
+            }
+        }
+    }
+
+    std::vector<std::uint32_t> targets(std::span<const std::uint32_t> from, unsigned char byte) const
+    {
+        std::vector<std::uint32_t> result;
+        targets(from, byte, result);
+        return result;
+    }
+
+    // Tags matched in `nfaStates`, sorted
+    void acceptedTags(std::span<const std::uint32_t> nfaStates, std::vector<std::uint32_t>& tags) const
+    {
+        tags.clear();
+        for (const auto nfaState : nfaStates)
+        {
+            if (nfa[nfaState].tag != none)
+            {
+                tags.push_back(nfa[nfaState].tag);
+            }
+        }
+
+        std::ranges::sort(tags);
+        tags.erase(std::ranges::unique(tags).begin(), tags.end());
+    }
+
+    // Adds a state to the cache, the caller holds the lock or is compile
+    // Its run is worked out from the NFA now, the transitions themselves are left to the walks
+    std::uint32_t addDfaState(std::vector<std::uint32_t> nfaStates) const
+    {
+        auto state = std::make_unique<DfaState>();
+        state->nfaStates = std::move(nfaStates);
+        acceptedTags(state->nfaStates, state->tags);
+        for (auto& next : state->next)
+        {
+            next.store(unknown, std::memory_order_relaxed);
+        }
+
+        // Bytes consumed by the same NFA states lead to the same state
+        std::map<std::vector<std::uint32_t>, bool> loops;
+        Bytes loop;
+        for (std::size_t byte = 0; byte < loop.size(); byte++)
+        {
+            auto [it, inserted] = loops.try_emplace(targets(state->nfaStates, static_cast<unsigned char>(byte)), false);
+            if (inserted && !it->first.empty())
+            {
+                it->second = closure(it->first) == state->nfaStates;
+            }
+
+            loop[byte] = it->second;
+        }
+
+        if (loop.any())
+        {
+            state->run = simd::ByteRanges::from(loop);
+        }
+
+        const auto id = cache->size++;
+        cache->ids.emplace(state->nfaStates, id);
+        cache->states[id] = std::move(state);
+        return id;
+    }
+
+    // Builds the transition on `byte` the first time a walk takes it, unknown if it leads to a state the full cache doesn't have
+    std::uint32_t transition(DfaState& from, unsigned char byte) const
+    {
+        auto nfaStates = closure(targets(from.nfaStates, byte));
+
+        std::lock_guard lock{cache->mutex};
+
+        auto& slot = from.next[byte];
+        if (const auto next = slot.load(std::memory_order_relaxed); next != unknown)
+        {
+            return next;
+        }
+
+        auto next = dead;
+        if (!nfaStates.empty())
+        {
+            if (const auto found = cache->ids.find(nfaStates); found != cache->ids.end())
+            {
+                next = found->second;
+            }
+            else if (cache->size < maxDfaStates)
+            {
+                next = addDfaState(std::move(nfaStates));
+            }
+            else
+            {
+                return unknown;
+            }
+        }
+
+        slot.store(next, std::memory_order_release);
+        return next;
+    }
+
+    // Rest of a walk past the cache, from the NFA states of the DFA state at `position`, the buffers are reused by every step
+    void walkNfa(std::string_view src, std::size_t index, std::size_t position, std::span<const std::uint32_t> from, const auto& onAccept) const
+    {
+        std::vector<std::uint32_t> current(from.begin(), from.end());
+        std::vector<std::uint32_t> next;
+        std::vector<std::uint32_t> tags;
+        ClosureScratch scratch;
+
+        for (; position < src.size(); position++)
+        {
+            targets(current, static_cast<unsigned char>(src[position]), next);
+            closure(next, scratch);
+            if (next.empty())
+            {
+                return;
+            }
+
+            std::swap(current, next);
+            acceptedTags(current, tags);
+            if (!tags.empty())
+            {
+                onAccept(std::span<const std::uint32_t>(tags), position + 1 - index);
+            }
+        }
+    }
+};
+
+} // namespace larley
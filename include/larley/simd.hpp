@@ -0,0 +1,172 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <bitset>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <utility>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define LARLEY_AVX2 1
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LARLEY_SSE2 1
+#endif
+
+namespace larley::simd
+{
+
+// Compares 32 or 16 bytes at once with AVX2 or SSE2, byte by byte otherwise
+inline bool equal(const char* first, const char* second, std::size_t size)
+{
+    std::size_t offset = 0;
+
+#if defined(LARLEY_AVX2)
+    for (; offset + 32 <= size; offset += 32)
+    {
+        const auto a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first + offset));
+        const auto b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(second + offset));
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b)) != -1)
+        {
+            return false;
+        }
+    }
+#endif
+
+#if defined(LARLEY_SSE2)
+    for (; offset + 16 <= size; offset += 16)
+    {
+        const auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first + offset));
+        const auto b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(second + offset));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) != 0xFFFF)
+        {
+            return false;
+        }
+    }
+#endif
+
+    for (; offset < size; offset++)
+    {
+        if (first[offset] != second[offset])
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Set of bytes made of a few ranges, like [^"\\], [a-zA-Z_0-9] or \s, that a run can be scanned for a vector at a time
+struct ByteRanges
+{
+    static constexpr std::size_t maxRanges = 4;
+
+    // Inclusive
+    std::array<std::pair<unsigned char, unsigned char>, maxRanges> ranges{};
+    std::size_t count{};
+
+    // nullopt if the bytes need more than maxRanges ranges
+    static std::optional<ByteRanges> from(const std::bitset<256>& bytes)
+    {
+        ByteRanges result;
+        for (std::size_t byte = 0; byte < bytes.size(); byte++)
+        {
+            if (!bytes[byte])
+            {
+                continue;
+            }
+
+            if (result.count == maxRanges)
+            {
+                return {};
+            }
+
+            auto last = byte;
+            while (last + 1 < bytes.size() && bytes[last + 1])
+            {
+                last++;
+            }
+
+            result.ranges[result.count++] = {static_cast<unsigned char>(byte), static_cast<unsigned char>(last)};
+            byte = last;
+        }
+
+        return result;
+    }
+
+    bool contains(unsigned char byte) const
+    {
+        for (std::size_t x = 0; x < count; x++)
+        {
+            if (byte >= ranges[x].first && byte <= ranges[x].second)
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+};
+
+// Index of the first byte from `index` that isn't in `bytes`, src.size() if the run goes to the end
+// A byte is in a range when byte - first <= last - first as unsigned, which vectors do with a saturating max
+inline std::size_t skipRun(std::string_view src, std::size_t index, const ByteRanges& bytes)
+{
+    const auto* data = reinterpret_cast<const unsigned char*>(src.data());
+
+#if defined(LARLEY_AVX2)
+    for (; index + 32 <= src.size(); index += 32)
+    {
+        const auto block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + index));
+
+        auto in = _mm256_setzero_si256();
+        for (std::size_t x = 0; x < bytes.count; x++)
+        {
+            const auto [first, last] = bytes.ranges[x];
+            const auto width = _mm256_set1_epi8(static_cast<char>(last - first));
+            const auto offset = _mm256_sub_epi8(block, _mm256_set1_epi8(static_cast<char>(first)));
+            in = _mm256_or_si256(in, _mm256_cmpeq_epi8(_mm256_max_epu8(offset, width), width));
+        }
+
+        if (const auto out = ~static_cast<std::uint32_t>(_mm256_movemask_epi8(in)))
+        {
+            return index + std::countr_zero(out);
+        }
+    }
+#endif
+
+#if defined(LARLEY_SSE2)
+    for (; index + 16 <= src.size(); index += 16)
+    {
+        const auto block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + index));
+
+        auto in = _mm_setzero_si128();
+        for (std::size_t x = 0; x < bytes.count; x++)
+        {
+            const auto [first, last] = bytes.ranges[x];
+            const auto width = _mm_set1_epi8(static_cast<char>(last - first));
+            const auto offset = _mm_sub_epi8(block, _mm_set1_epi8(static_cast<char>(first)));
+            in = _mm_or_si128(in, _mm_cmpeq_epi8(_mm_max_epu8(offset, width), width));
+        }
+
+        if (const auto out = ~static_cast<std::uint32_t>(_mm_movemask_epi8(in)) & 0xFFFF)
+        {
+            return index + std::countr_zero(out);
+        }
+    }
+#endif
+
+    while (index < src.size() && bytes.contains(data[index]))
+    {
+        index++;
+    }
+
+    return index;
+}
+
+} // namespace larley::simd
@@ -0,0 +1,504 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <initializer_list>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "grammar.hpp"
+#include "utils.hpp"
+
+namespace larley
+{
+
+// Symbol of a StaticRule, a non-terminal or a terminal
+template <typename NonTerminalT, typename TerminalT>
+struct StaticSymbol
+{
+    bool isTerminal{};
+    NonTerminalT nonTerminal{};
+    TerminalT terminal{};
+
+    constexpr StaticSymbol() = default;
+
+    constexpr StaticSymbol(NonTerminalT nonTerminal) : nonTerminal{nonTerminal}
+    {
+    }
+
+    constexpr StaticSymbol(TerminalT terminal) : isTerminal{true}, terminal{terminal}
+    {
+    }
+};
+
+// Rule of a StaticGrammar, its terminals have to be literal types, like the token types of a lexer or chars
+template <typename NonTerminalT, typename TerminalT, std::size_t MaxSymbols = 8>
+struct StaticRule
+{
+    using NonTerminal = NonTerminalT;
+    using Terminal = TerminalT;
+    using Symbol = StaticSymbol<NonTerminalT, TerminalT>;
+
+    NonTerminal product{};
+    std::array<Symbol, MaxSymbols> symbols{};
+    std::size_t size{};
+
+    constexpr StaticRule(NonTerminal product, std::initializer_list<Symbol> symbols) : product{product}, size{symbols.size()}
+    {
+        if (symbols.size() > MaxSymbols)
+        {
+            throw std::length_error("invalid grammar, rule longer than MaxSymbols");
+        }
+
+        std::ranges::copy(symbols, this->symbols.begin());
+    }
+};
+
+// TerminalLookahead whose first() can be called in constant expressions
+template <typename Terminal>
+concept ConstantLookahead = TerminalLookahead<Terminal>::size > 0 && requires {
+    typename std::bool_constant<(TerminalLookahead<Terminal>::first(Terminal{}), true)>;
+};
+
+// Grammar whose tables are made by the compiler, `Rules` being a constexpr array of StaticRule
+// The dotted rules, the nullables, the prediction closures and the terminal ids are fixed-size arrays, and a recursive
+// nullable fails the build instead of throwing at startup
+// The Grammar made from it copies them instead of computing them, the FIRST sets too when the terminals' lookahead is a
+// ConstantLookahead, otherwise those are still made then
+// The id of a rule is its index in `Rules`, it's what Semantics::setAction takes
+template <auto StartSymbol, const auto& Rules>
+struct StaticGrammar
+{
+    using RuleType = std::remove_cvref_t<decltype(Rules[0])>;
+    using NT = RuleType::NonTerminal;
+    using LT = RuleType::Terminal;
+
+    static constexpr std::uint32_t noPrediction = std::numeric_limits<std::uint32_t>::max();
+    static constexpr std::uint32_t noTerminal = std::numeric_limits<std::uint32_t>::max();
+
+    static constexpr bool HasFirstSets = ConstantLookahead<LT>;
+    static constexpr std::size_t lookaheadSize = TerminalLookahead<LT>::size;
+    static constexpr std::size_t lookaheadWords = (lookaheadSize + 63) / 64;
+
+    struct DottedRule
+    {
+        std::uint32_t rule;
+        std::uint32_t dot;
+    };
+
+  private:
+    // Made by constant evaluation, the vectors can't outlive it and are copied into the arrays below
+    struct Tables
+    {
+        // Every non-terminal of the grammar, indexes into the nullables
+        std::vector<NT> nonTerminals;
+        std::vector<bool> nullables;
+
+        std::vector<std::uint32_t> ruleToDottedRule;
+        std::vector<DottedRule> dottedRules;
+
+        // Prediction x is predictionItems[predictionStarts[x], predictionStarts[x + 1])
+        std::vector<std::uint32_t> predictionStarts;
+        std::vector<std::uint32_t> predictionItems;
+        std::vector<std::uint32_t> dottedRuleToPrediction;
+        std::uint32_t startPrediction{};
+
+        std::vector<std::uint32_t> terminalIds;
+        std::uint32_t terminalCount{};
+
+        // FIRST set of each dotted rule's suffix as lookaheadWords words, only made if HasFirstSets
+        std::vector<std::uint64_t> firstSets;
+        std::vector<bool> nullableSuffixes;
+    };
+
+    // Same tables as the Grammar constructor makes, in the same order so that both give the same charts
+    static constexpr Tables makeTables()
+    {
+        Tables tables;
+
+        const auto getId = [&](NT symbol) -> std::size_t
+        {
+            const auto it = std::ranges::find(tables.nonTerminals, symbol);
+            if (it != tables.nonTerminals.end())
+            {
+                return static_cast<std::size_t>(it - tables.nonTerminals.begin());
+            }
+
+            tables.nonTerminals.push_back(symbol);
+            return tables.nonTerminals.size() - 1;
+        };
+
+        getId(StartSymbol);
+        for (const auto& rule : Rules)
+        {
+            getId(rule.product);
+            for (std::size_t x = 0; x < rule.size; x++)
+            {
+                if (!rule.symbols[x].isTerminal)
+                {
+                    getId(rule.symbols[x].nonTerminal);
+                }
+            }
+        }
+
+        const auto count = tables.nonTerminals.size();
+        auto& nullables = tables.nullables;
+        nullables.assign(count, false);
+
+        const auto isNullable = [&](const RuleType& rule)
+        {
+            for (std::size_t x = 0; x < rule.size; x++)
+            {
+                if (rule.symbols[x].isTerminal || !nullables[getId(rule.symbols[x].nonTerminal)])
+                {
+                    return false;
+                }
+            }
+
+            return true;
+        };
+
+        for (bool changed = true; changed;)
+        {
+            changed = false;
+            for (const auto& rule : Rules)
+            {
+                if (!nullables[getId(rule.product)] && isNullable(rule))
+                {
+                    nullables[getId(rule.product)] = true;
+                    changed = true;
+                }
+            }
+        }
+
+        // A non-terminal reaching itself through nullable rules, like Grammar::check
+        std::vector<bool> reaches(count * count);
+        for (const auto& rule : Rules)
+        {
+            if (isNullable(rule))
+            {
+                for (std::size_t x = 0; x < rule.size; x++)
+                {
+                    reaches[getId(rule.product) * count + getId(rule.symbols[x].nonTerminal)] = true;
+                }
+            }
+        }
+
+        for (std::size_t via = 0; via < count; via++)
+        {
+            for (std::size_t from = 0; from < count; from++)
+            {
+                if (!reaches[from * count + via])
+                {
+                    continue;
+                }
+
+                for (std::size_t to = 0; to < count; to++)
+                {
+                    if (reaches[via * count + to])
+                    {
+                        reaches[from * count + to] = true;
+                    }
+                }
+            }
+        }
+
+        for (std::size_t x = 0; x < count; x++)
+        {
+            if (reaches[x * count + x])
+            {
+                throw std::logic_error("invalid grammar, recursive nullable");
+            }
+        }
+
+        for (std::uint32_t rule = 0; rule < std::size(Rules); rule++)
+        {
+            tables.ruleToDottedRule.push_back(static_cast<std::uint32_t>(tables.dottedRules.size()));
+            for (std::uint32_t dot = 0; dot <= Rules[rule].size; dot++)
+            {
+                tables.dottedRules.push_back({rule, dot});
+            }
+        }
+
+        const auto getPostdot = [&](std::uint32_t dottedRule) -> const typename RuleType::Symbol*
+        {
+            const auto [rule, dot] = tables.dottedRules[dottedRule];
+            return dot < Rules[rule].size ? &Rules[rule].symbols[dot] : nullptr;
+        };
+
+        std::vector<std::uint32_t> closureIds(count, noPrediction);
+        tables.predictionStarts.push_back(0);
+        const auto getClosure = [&](NT symbol)
+        {
+            const auto id = getId(symbol);
+            if (closureIds[id] != noPrediction)
+            {
+                return closureIds[id];
+            }
+
+            std::vector<NT> predicted{symbol};
+            std::vector<bool> seen(count);
+            seen[id] = true;
+            for (std::size_t x = 0; x < predicted.size(); x++)
+            {
+                for (std::size_t rule = 0; rule < std::size(Rules); rule++)
+                {
+                    if (Rules[rule].product != predicted[x])
+                    {
+                        continue;
+                    }
+
+                    const auto first = tables.ruleToDottedRule[rule];
+                    tables.predictionItems.push_back(first);
+
+                    for (std::size_t dot = 0; dot < Rules[rule].size; dot++)
+                    {
+                        const auto& next = Rules[rule].symbols[dot];
+                        if (next.isTerminal)
+                        {
+                            break;
+                        }
+
+                        const auto nextId = getId(next.nonTerminal);
+                        if (!seen[nextId])
+                        {
+                            seen[nextId] = true;
+                            predicted.push_back(next.nonTerminal);
+                        }
+
+                        if (!nullables[nextId])
+                        {
+                            break;
+                        }
+
+                        tables.predictionItems.push_back(first + static_cast<std::uint32_t>(dot) + 1);
+                    }
+                }
+            }
+
+            closureIds[id] = static_cast<std::uint32_t>(tables.predictionStarts.size() - 1);
+            tables.predictionStarts.push_back(static_cast<std::uint32_t>(tables.predictionItems.size()));
+            return closureIds[id];
+        };
+
+        std::vector<LT> terminals;
+        for (std::uint32_t x = 0; x < tables.dottedRules.size(); x++)
+        {
+            const auto* symbol = getPostdot(x);
+            tables.dottedRuleToPrediction.push_back(symbol && !symbol->isTerminal ? getClosure(symbol->nonTerminal) : noPrediction);
+
+            if (!symbol || !symbol->isTerminal)
+            {
+                tables.terminalIds.push_back(noTerminal);
+                continue;
+            }
+
+            auto it = terminals.end();
+            if constexpr (isEqualityComparable<LT>)
+            {
+                it = std::ranges::find(terminals, symbol->terminal);
+            }
+
+            if (it == terminals.end())
+            {
+                it = terminals.insert(terminals.end(), symbol->terminal);
+            }
+
+            tables.terminalIds.push_back(static_cast<std::uint32_t>(it - terminals.begin()));
+        }
+
+        tables.startPrediction = getClosure(StartSymbol);
+        tables.terminalCount = static_cast<std::uint32_t>(terminals.size());
+
+        if constexpr (HasFirstSets)
+        {
+            makeFirstSets(tables, getId);
+        }
+
+        return tables;
+    }
+
+    // Same fixed point as Grammar::makeFirstSets, on words since not every standard library has a constexpr std::bitset yet
+    static constexpr void makeFirstSets(Tables& tables, const auto& getId)
+    {
+        using Words = std::array<std::uint64_t, lookaheadWords>;
+
+        const auto unite = [](Words& to, const Words& from)
+        {
+            bool changed = false;
+            for (std::size_t x = 0; x < lookaheadWords; x++)
+            {
+                changed |= (to[x] | from[x]) != to[x];
+                to[x] |= from[x];
+            }
+
+            return changed;
+        };
+
+        auto& firstSets = tables.firstSets;
+        auto& nullableSuffixes = tables.nullableSuffixes;
+        firstSets.assign(tables.dottedRules.size() * lookaheadWords, 0);
+        nullableSuffixes.assign(tables.dottedRules.size(), false);
+
+        std::vector<Words> nonTerminalFirsts(tables.nonTerminals.size());
+        for (bool changed = true; changed;)
+        {
+            changed = false;
+
+            for (std::size_t rule = 0; rule < std::size(Rules); rule++)
+            {
+                const auto first = tables.ruleToDottedRule[rule];
+
+                Words suffix{};
+                bool nullable = true;
+                for (auto dot = Rules[rule].size + 1; dot-- > 0;)
+                {
+                    if (dot < Rules[rule].size)
+                    {
+                        const auto& symbol = Rules[rule].symbols[dot];
+                        if (symbol.isTerminal)
+                        {
+                            const auto bits = TerminalLookahead<LT>::first(symbol.terminal);
+                            suffix = {};
+                            for (std::size_t x = 0; x < lookaheadSize; x++)
+                            {
+                                if (bits[x])
+                                {
+                                    suffix[x / 64] |= std::uint64_t{1} << (x % 64);
+                                }
+                            }
+                            nullable = false;
+                        }
+                        else if (const auto id = getId(symbol.nonTerminal); tables.nullables[id])
+                        {
+                            unite(suffix, nonTerminalFirsts[id]);
+                        }
+                        else
+                        {
+                            suffix = nonTerminalFirsts[id];
+                            nullable = false;
+                        }
+                    }
+
+                    std::ranges::copy(suffix, firstSets.begin() + (first + dot) * lookaheadWords);
+                    nullableSuffixes[first + dot] = nullable;
+                }
+
+                changed |= unite(nonTerminalFirsts[getId(Rules[rule].product)], suffix);
+            }
+        }
+    }
+
+    template <std::size_t Size, typename T>
+    static constexpr auto toArray(const std::vector<T>& values)
+    {
+        std::array<T, Size> result{};
+        std::ranges::copy(values, result.begin());
+        return result;
+    }
+
+  public:
+    static constexpr std::size_t ruleCount = std::size(Rules);
+    static constexpr std::size_t nonTerminalCount = makeTables().nonTerminals.size();
+    static constexpr std::size_t dottedRuleCount = makeTables().dottedRules.size();
+    static constexpr std::size_t predictionCount = makeTables().predictionStarts.size() - 1;
+    static constexpr std::size_t predictionItemCount = makeTables().predictionItems.size();
+
+    static constexpr auto nonTerminals = toArray<nonTerminalCount>(makeTables().nonTerminals);
+    static constexpr auto nullables = toArray<nonTerminalCount>(makeTables().nullables);
+
+    static constexpr auto ruleToDottedRule = toArray<ruleCount>(makeTables().ruleToDottedRule);
+    static constexpr auto dottedRules = toArray<dottedRuleCount>(makeTables().dottedRules);
+
+    static constexpr auto predictionStarts = toArray<predictionCount + 1>(makeTables().predictionStarts);
+    static constexpr auto predictionItems = toArray<predictionItemCount>(makeTables().predictionItems);
+    static constexpr auto dottedRuleToPrediction = toArray<dottedRuleCount>(makeTables().dottedRuleToPrediction);
+    static constexpr std::uint32_t startPrediction = makeTables().startPrediction;
+
+    static constexpr auto terminalIds = toArray<dottedRuleCount>(makeTables().terminalIds);
+    static constexpr std::uint32_t terminalCount = makeTables().terminalCount;
+
+    static constexpr auto firstSets = toArray<HasFirstSets ? dottedRuleCount * lookaheadWords : 0>(makeTables().firstSets);
+    static constexpr auto nullableSuffixes = toArray<HasFirstSets ? dottedRuleCount : 0>(makeTables().nullableSuffixes);
+
+    template <typename ParserTypes>
+    static Grammar<ParserTypes> grammar()
+    {
+        static_assert(std::is_same_v<typename ParserTypes::NonTerminal, NT> && std::is_same_v<typename ParserTypes::Terminal, LT>, "the parser types must have the rules' symbol types");
+
+        using GrammarT = Grammar<ParserTypes>;
+        using RuleT = Rule<ParserTypes>;
+
+        std::vector<RuleT> rules;
+        rules.reserve(ruleCount);
+        for (std::size_t x = 0; x < ruleCount; x++)
+        {
+            auto& rule = rules.emplace_back(RuleT{Rules[x].product, {}, x, 0});
+            for (const auto& symbol : std::span(Rules[x].symbols).first(Rules[x].size))
+            {
+                if (symbol.isTerminal)
+                {
+                    rule.add(typename RuleT::Symbol{std::in_place_index<1>, symbol.terminal});
+                }
+                else
+                {
+                    rule.add(typename RuleT::Symbol{std::in_place_index<0>, symbol.nonTerminal});
+                }
+            }
+        }
+
+        typename GrammarT::Tables tables;
+        for (std::size_t x = 0; x < nonTerminalCount; x++)
+        {
+            if (nullables[x])
+            {
+                tables.nullables.insert(nonTerminals[x]);
+            }
+        }
+
+        tables.dottedRules.reserve(dottedRuleCount);
+        for (const auto [rule, dot] : dottedRules)
+        {
+            tables.dottedRules.push_back({rule, dot});
+        }
+
+        tables.ruleToDottedRule.assign(ruleToDottedRule.begin(), ruleToDottedRule.end());
+
+        tables.predictions.reserve(predictionCount);
+        for (std::size_t x = 0; x < predictionCount; x++)
+        {
+            tables.predictions.emplace_back(predictionItems.begin() + predictionStarts[x], predictionItems.begin() + predictionStarts[x + 1]);
+        }
+
+        tables.dottedRuleToPrediction.assign(dottedRuleToPrediction.begin(), dottedRuleToPrediction.end());
+        tables.startPrediction = startPrediction;
+
+        tables.terminalIds.assign(terminalIds.begin(), terminalIds.end());
+        tables.terminalCount = terminalCount;
+
+        if constexpr (HasFirstSets)
+        {
+            tables.firstSets.resize(dottedRuleCount);
+            for (std::size_t x = 0; x < dottedRuleCount; x++)
+            {
+                for (std::size_t bit = 0; bit < lookaheadSize; bit++)
+                {
+                    if ((firstSets[x * lookaheadWords + bit / 64] >> (bit % 64)) & 1)
+                    {
+                        tables.firstSets[x].set(bit);
+                    }
+                }
+            }
+
+            tables.nullableSuffixes.assign(nullableSuffixes.begin(), nullableSuffixes.end());
+        }
+
+        return GrammarT{StartSymbol, std::move(rules), std::move(tables)};
+    }
+};
+
+} // namespace larley
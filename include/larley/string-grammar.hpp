@@ -1,14 +1,26 @@
 #pragma once
 
 #include <array>
+#include <bitset>
+#include <cctype>
+#include <climits>
+#include <limits>
+#include <memory>
 #include <regex>
+#include <stdexcept>
 #include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
 #include <variant>
 #include <vector>
 #include <optional>
 #include <sstream>
 
+#include "dictionary.hpp"
 #include "parser.hpp"
+#include "regex.hpp"
+#include "simd.hpp"
 #include "utils.hpp"
 
 namespace larley
@@ -19,14 +31,52 @@ namespace StringGrammar
 
 using Str = std::string;
 
-struct SavedRegex : public std::regex
+// Matched by RegexAutomaton, which gives the longest match
+// Patterns using syntax it doesn't support, see RegexAutomaton::add, go through std::regex and its leftmost alternative instead
+// Copies share the compiled automaton or regex
+struct SavedRegex
 {
-    SavedRegex(std::string pattern) : std::regex(pattern), pattern{ std::move(pattern) }
+    SavedRegex(std::string pattern) : pattern{ std::move(pattern) }
     {
+        auto native = std::make_shared<RegexAutomaton>();
+        if (native->add(this->pattern, 0))
+        {
+            native->compile();
+            automaton = std::move(native);
+        }
+        else
+        {
+            fallback = std::make_shared<const std::regex>(this->pattern);
+        }
+    }
+
+    // Regexes built from the same pattern match the same things
+    bool operator==(const SavedRegex& other) const
+    {
+        return pattern == other.pattern;
+    }
+
+    // Length of the longest match at `index`, -1 if there is none
+    int match(std::string_view src, std::size_t index) const
+    {
+        if (automaton)
+        {
+            return automaton->match(src, index);
+        }
+
+        if (std::cmatch match; std::regex_search(src.data() + index, src.data() + src.size(), match, *fallback, std::regex_constants::match_continuous))
+        {
+            return static_cast<int>(match.length());
+        }
 
+        return -1;
     }
 
     std::string pattern;
+
+    // Only one of them is set
+    std::shared_ptr<const RegexAutomaton> automaton;
+    std::shared_ptr<const std::regex> fallback;
 };
 
 using LiteralTerminalSymbol = Str;
@@ -35,7 +85,134 @@ using ChoiceTerminalSymbol = std::vector<LiteralTerminalSymbol>;
 using RangeTerminalSymbol = std::pair<LiteralTerminalSymbol, LiteralTerminalSymbol>;
 using RegexTerminalSymbol = SavedRegex;
 
-using TerminalSymbol = std::variant<LiteralTerminalSymbol, ChoiceTerminalSymbol, RangeTerminalSymbol, RegexTerminalSymbol>;
+// Matches the longest word of a dictionary, meant for word lists too big for a choice
+// The automaton is built once and shared read-only by the copies of the grammar and so by every parser made from it
+struct DictionaryTerminalSymbol
+{
+    Str name;
+    std::shared_ptr<const DictionaryAutomaton> automaton;
+
+    // Compared by identity, comparing the words would cost as much as building them again
+    bool operator==(const DictionaryTerminalSymbol& other) const
+    {
+        return automaton == other.automaton;
+    }
+};
+
+// Appends a byte to a regex pattern, escaped so that it works both in and out of brackets
+void appendPatternByte(std::string& pattern, std::size_t byte)
+{
+    if (std::isalnum(static_cast<int>(byte)))
+    {
+        pattern += static_cast<char>(byte);
+    }
+    else if (byte >= 0x20 && byte < 0x7f)
+    {
+        pattern += '\\';
+        pattern += static_cast<char>(byte);
+    }
+    else
+    {
+        constexpr std::string_view digits = "0123456789abcdef";
+        pattern += "\\x";
+        pattern += digits[byte / 16];
+        pattern += digits[byte % 16];
+    }
+}
+
+// Bracket matching one of `bytes`, written as ranges
+std::string classPattern(const std::bitset<256>& bytes)
+{
+    std::string pattern = "[";
+    for (std::size_t byte = 0; byte < bytes.size(); byte++)
+    {
+        if (!bytes[byte])
+        {
+            continue;
+        }
+
+        auto last = byte;
+        while (last + 1 < bytes.size() && bytes[last + 1])
+        {
+            last++;
+        }
+
+        appendPatternByte(pattern, byte);
+        if (last > byte)
+        {
+            pattern += '-';
+            appendPatternByte(pattern, last);
+        }
+
+        byte = last;
+    }
+
+    return pattern + "]";
+}
+
+// Matches one byte out of a set, or with `repeat` the whole run of them, without an item per byte
+// The set is a table, a run is scanned with simd::skipRun when the set is a few ranges and a lookup per byte otherwise
+// A run is never empty, the chart doesn't scan empty matches, a rule can leave the terminal out instead
+struct ClassTerminalSymbol
+{
+    using Bytes = std::bitset<256>;
+
+    ClassTerminalSymbol(const Bytes& bytes, bool repeat = false) : bytes{bytes}, repeat{repeat}, ranges{simd::ByteRanges::from(bytes)}
+    {
+    }
+
+    // From the inside of a regex bracket like "0-9a-f", "^\"\\" or "\\w-"
+    static ClassTerminalSymbol parse(std::string_view spec, bool repeat = false)
+    {
+        const auto bytes = RegexAutomaton::parseClass(spec);
+        if (!bytes || bytes->none())
+        {
+            throw std::invalid_argument("invalid class, " + std::string(spec));
+        }
+
+        return {*bytes, repeat};
+    }
+
+    bool operator==(const ClassTerminalSymbol& other) const
+    {
+        return bytes == other.bytes && repeat == other.repeat;
+    }
+
+    int match(std::string_view src, std::size_t index) const
+    {
+        if (index >= src.size() || !bytes[static_cast<unsigned char>(src[index])])
+        {
+            return -1;
+        }
+
+        if (!repeat)
+        {
+            return 1;
+        }
+
+        auto end = index + 1;
+        if (ranges)
+        {
+            end = simd::skipRun(src, end, *ranges);
+        }
+        else
+        {
+            while (end < src.size() && bytes[static_cast<unsigned char>(src[end])])
+            {
+                end++;
+            }
+        }
+
+        return static_cast<int>(end - index);
+    }
+
+    Bytes bytes;
+    bool repeat;
+
+    std::optional<simd::ByteRanges> ranges;
+};
+
+using TerminalSymbol = std::variant<LiteralTerminalSymbol, ChoiceTerminalSymbol, RangeTerminalSymbol, RegexTerminalSymbol, DictionaryTerminalSymbol, ClassTerminalSymbol>;
 
 int match(std::string_view src, size_t index, const TerminalSymbol& terminal)
 {
@@ -46,24 +223,23 @@ int match(std::string_view src, size_t index, const TerminalSymbol& terminal)
             return -1;
         }
 
-        const std::string_view subsrc(src.begin() + index, src.begin() + index + symbol->size());
-        const auto matches = subsrc == *symbol;
-
-        return matches ? static_cast<int>(subsrc.size()) : -1;
+        const auto matches = simd::equal(src.data() + index, symbol->data(), symbol->size());
+        return matches ? static_cast<int>(symbol->size()) : -1;
     }
     else if (auto* symbol = std::get_if<ChoiceTerminalSymbol>(&terminal))
     {
+        // Most partials differ by their first byte, only the others get compared
+        const auto remaining = src.size() - index;
         for (const auto& partial : *symbol)
         {
-            if (index + partial.size() >= src.size())
+            if (partial.empty())
             {
-                continue;
+                return 0;
             }
 
-            const std::string_view subsrc(src.begin() + index, src.begin() + index + partial.size());
-            if (const auto matches = subsrc == partial)
+            if (partial.size() <= remaining && partial[0] == src[index] && simd::equal(src.data() + index + 1, partial.data() + 1, partial.size() - 1))
             {
-                return static_cast<int>(subsrc.size());
+                return static_cast<int>(partial.size());
             }
         }
 
@@ -90,17 +266,40 @@ int match(std::string_view src, size_t index, const TerminalSymbol& terminal)
             return -1;
         }
 
-        if (std::cmatch match; std::regex_search(src.data() + index, src.data() + src.size(), match, *symbol, std::regex_constants::match_continuous))
-        {
-            return match[0].length();
-        }
-
-        return -1;
+        return symbol->match(src, index);
+    }
+    else if (auto* symbol = std::get_if<DictionaryTerminalSymbol>(&terminal))
+    {
+        return symbol->automaton->longestMatch(src, index);
+    }
+    else if (auto* symbol = std::get_if<ClassTerminalSymbol>(&terminal))
+    {
+        return symbol->match(src, index);
     }
 
     std::unreachable();
 }
 
+// Calls match without going through a std::function, use it as the MatcherT of ParserTypes for the recognizer to inline it
+struct Matcher
+{
+    int operator()(std::string_view src, std::size_t index, const TerminalSymbol& terminal) const
+    {
+        return match(src, index, terminal);
+    }
+};
+
+// Parser::skipper skipping the longest match of a regex, whitespace and comments are usually a single DFA walk
+struct RegexSkipper
+{
+    SavedRegex regex;
+
+    std::size_t operator()(std::string_view src, std::size_t index) const
+    {
+        return index < src.size() ? static_cast<std::size_t>(std::max(regex.match(src, index), 0)) : 0;
+    }
+};
+
 std::ostream& operator<<(std::ostream& os, const StringGrammar::TerminalSymbol& symbol)
 {
     using namespace StringGrammar;
@@ -142,6 +341,14 @@ std::ostream& operator<<(std::ostream& os, const StringGrammar::TerminalSymbol&
             [&](const RegexTerminalSymbol& symbol)
             {
                 os << '/' << symbol.pattern << '/';
+            },
+            [&](const DictionaryTerminalSymbol& symbol)
+            {
+                os << '<' << symbol.name << ", " << symbol.automaton->size() << " words>";
+            },
+            [&](const ClassTerminalSymbol& symbol)
+            {
+                os << classPattern(symbol.bytes) << (symbol.repeat ? "+" : "");
             }},
         symbol);
 
@@ -150,6 +357,603 @@ std::ostream& operator<<(std::ostream& os, const StringGrammar::TerminalSymbol&
 
 } // namespace StringGrammar
 
+// The lookahead of string grammars is the next byte of the input
+template <>
+struct TerminalLookahead<StringGrammar::TerminalSymbol>
+{
+    static constexpr std::size_t size = 256;
+    using Bytes = std::bitset<size>;
+
+    static Bytes first(const StringGrammar::TerminalSymbol& terminal)
+    {
+        using namespace StringGrammar;
+
+        Bytes bytes;
+        if (auto* symbol = std::get_if<LiteralTerminalSymbol>(&terminal))
+        {
+            if (!symbol->empty())
+            {
+                bytes.set(static_cast<unsigned char>(symbol->front()));
+            }
+        }
+        else if (auto* symbol = std::get_if<ChoiceTerminalSymbol>(&terminal))
+        {
+            for (const auto& partial : *symbol)
+            {
+                if (!partial.empty())
+                {
+                    bytes.set(static_cast<unsigned char>(partial.front()));
+                }
+            }
+        }
+        else if (auto* symbol = std::get_if<RangeTerminalSymbol>(&terminal))
+        {
+            // Compared as chars by match, which might be signed
+            for (int x = CHAR_MIN; x <= CHAR_MAX; x++)
+            {
+                const auto c = static_cast<char>(x);
+                if (c >= symbol->first[0] && c <= symbol->second[0])
+                {
+                    bytes.set(static_cast<unsigned char>(c));
+                }
+            }
+        }
+        else if (auto* symbol = std::get_if<RegexTerminalSymbol>(&terminal))
+        {
+            // The matches that count are never empty, std::regex's can start with anything
+            bytes = symbol->automaton ? symbol->automaton->firstBytes() : Bytes{}.set();
+        }
+        else if (auto* symbol = std::get_if<DictionaryTerminalSymbol>(&terminal))
+        {
+            bytes = symbol->automaton->firstBytes();
+        }
+        else if (auto* symbol = std::get_if<ClassTerminalSymbol>(&terminal))
+        {
+            bytes = symbol->bytes;
+        }
+
+        return bytes;
+    }
+
+    static std::size_t at(std::string_view src, std::size_t index)
+    {
+        return static_cast<unsigned char>(src[index]);
+    }
+};
+
+namespace StringGrammar
+{
+
+// Replaces the non-terminals whose language is regular by a regex terminal matching the same strings
+// The chart then scans them in one step instead of spending an item or more per byte on them
+//
+// A non-terminal is regular here if its sub-grammar is strongly regular: the rules of each group of mutually recursive
+// non-terminals are all right-linear or all left-linear, their regexes are solved like a system of equations
+// Its terminals must match a single length at a time, like they would in the regex: literals, ranges, choices where no
+// partial is a prefix of another and prefix-free regexes the native engine supports
+//
+// A terminal only gives its longest match, so a non-terminal is only replaced where no byte that can extend one of its matches
+// can follow it. It also can't be nullable nor the start symbol
+// When the parser skips input before terminals, see Parser::skipper, the skipped input could appear between any two of them,
+// so only the sub-grammars where every rule has a single symbol are replaced and the bytes it can start with can follow them all
+// The sub-grammars with semantic actions get an expansion, parseTree parses their span again to put their subtree back
+template <typename ParserTypes>
+Grammar<ParserTypes> lexicalize(const Grammar<ParserTypes>& grammar, const Semantics<ParserTypes>& semantics, const std::optional<RegexSkipper>& skipper = {})
+{
+    using NT = ParserTypes::NonTerminal;
+    using RuleT = Rule<ParserTypes>;
+
+    // Patterns are kept safe to concatenate by always grouping alternatives, nullopt is the empty language
+    using Pattern = std::optional<std::string>;
+
+    // Past that a sub-grammar is left to the parser
+    constexpr std::size_t maxPatternSize = 1 << 14;
+    bool tooBig = false;
+
+    const auto checkSize = [&](Pattern pattern)
+    {
+        tooBig = tooBig || (pattern && pattern->size() > maxPatternSize);
+        return pattern;
+    };
+
+    const auto alternative = [&](const Pattern& first, const Pattern& second) -> Pattern
+    {
+        if (!first)
+        {
+            return second;
+        }
+
+        if (!second || *first == *second)
+        {
+            return first;
+        }
+
+        return checkSize("(?:" + *first + "|" + *second + ")");
+    };
+
+    const auto concatenation = [&](const Pattern& first, const Pattern& second) -> Pattern
+    {
+        if (!first || !second)
+        {
+            return {};
+        }
+
+        return checkSize(*first + *second);
+    };
+
+    const auto repetition = [&](const Pattern& pattern) -> Pattern
+    {
+        if (!pattern || pattern->empty())
+        {
+            return std::string{};
+        }
+
+        return checkSize("(?:" + *pattern + ")*");
+    };
+
+    const auto literalPattern = [&](std::string_view literal)
+    {
+        std::string pattern;
+        for (const auto c : literal)
+        {
+            appendPatternByte(pattern, static_cast<unsigned char>(c));
+        }
+
+        return pattern;
+    };
+
+    // nullopt if the terminal can't be part of a regex
+    const auto terminalPattern = [&](const TerminalSymbol& terminal) -> std::optional<std::string>
+    {
+        if (auto* symbol = std::get_if<LiteralTerminalSymbol>(&terminal))
+        {
+            return literalPattern(*symbol);
+        }
+        else if (auto* symbol = std::get_if<ChoiceTerminalSymbol>(&terminal))
+        {
+            Pattern pattern;
+            for (const auto& partial : *symbol)
+            {
+                // match takes the first partial that matches, it's the only one if none is a prefix of another
+                for (const auto& other : *symbol)
+                {
+                    if (other.size() > partial.size() && other.starts_with(partial))
+                    {
+                        return {};
+                    }
+                }
+
+                pattern = alternative(pattern, literalPattern(partial));
+            }
+
+            return pattern;
+        }
+        else if (std::holds_alternative<RangeTerminalSymbol>(terminal))
+        {
+            const auto bytes = TerminalLookahead<TerminalSymbol>::first(terminal);
+            if (bytes.none())
+            {
+                return {};
+            }
+
+            return classPattern(bytes);
+        }
+        else if (auto* symbol = std::get_if<ClassTerminalSymbol>(&terminal))
+        {
+            // A run is the longest one, which a regex repetition isn't
+            if (symbol->repeat)
+            {
+                return {};
+            }
+
+            return classPattern(symbol->bytes);
+        }
+        else if (auto* symbol = std::get_if<RegexTerminalSymbol>(&terminal))
+        {
+            const auto extending = symbol->automaton ? symbol->automaton->extendingBytes() : std::nullopt;
+            if (!extending || extending->any())
+            {
+                return {};
+            }
+
+            return "(?:" + symbol->pattern + ")";
+        }
+
+        return {};
+    };
+
+    std::unordered_map<NT, std::vector<const RuleT*>> productRules;
+    for (const auto& rule : grammar.rules)
+    {
+        productRules[rule.product].push_back(&rule);
+    }
+
+    // Tarjan's algorithm, a group of mutually recursive non-terminals comes after the groups it uses
+    std::vector<std::vector<NT>> components;
+    std::unordered_map<NT, std::size_t> indices;
+    std::unordered_map<NT, std::size_t> lowLinks;
+    std::vector<NT> stack;
+    std::unordered_set<NT> onStack;
+
+    const auto connect = [&](this auto const& connect, NT symbol) -> void
+    {
+        const auto index = indices.size();
+        indices[symbol] = index;
+        lowLinks[symbol] = index;
+        stack.push_back(symbol);
+        onStack.insert(symbol);
+
+        for (const auto* rule : productRules[symbol])
+        {
+            for (const auto& ruleSymbol : rule->symbols)
+            {
+                const auto* nt = std::get_if<0>(&ruleSymbol);
+                if (!nt)
+                {
+                    continue;
+                }
+
+                if (!indices.contains(*nt))
+                {
+                    connect(*nt);
+                    lowLinks[symbol] = std::min(lowLinks[symbol], lowLinks[*nt]);
+                }
+                else if (onStack.contains(*nt))
+                {
+                    lowLinks[symbol] = std::min(lowLinks[symbol], indices[*nt]);
+                }
+            }
+        }
+
+        if (lowLinks[symbol] != indices[symbol])
+        {
+            return;
+        }
+
+        auto& component = components.emplace_back();
+        while (true)
+        {
+            const auto member = stack.back();
+            stack.pop_back();
+            onStack.erase(member);
+            component.push_back(member);
+
+            if (member == symbol)
+            {
+                break;
+            }
+        }
+    };
+
+    for (const auto& rule : grammar.rules)
+    {
+        if (!indices.contains(rule.product))
+        {
+            connect(rule.product);
+        }
+    }
+
+    // Regex of each regular non-terminal
+    std::unordered_map<NT, std::string> patterns;
+
+    // X_i = Σ a_ij X_j + b_i for right-linear rules and X_i = Σ X_j a_ij + b_i for left-linear ones
+    // Each member is solved by eliminating the others, X_m = a_mm* b_m or b_m a_mm*
+    const auto solve = [&](const std::vector<NT>& component) -> std::optional<std::vector<std::string>>
+    {
+        const auto size = component.size();
+        const auto memberIndex = [&](const NT& symbol) { return static_cast<std::size_t>(std::ranges::find(component, symbol) - component.begin()); };
+
+        std::vector<std::vector<Pattern>> coefficients(size, std::vector<Pattern>(size));
+        std::vector<Pattern> constants(size);
+        std::optional<bool> rightLinear;
+
+        for (std::size_t i = 0; i < size; i++)
+        {
+            for (const auto* rule : productRules[component[i]])
+            {
+                const auto& symbols = rule->symbols;
+                if (skipper && symbols.size() > 1)
+                {
+                    return {};
+                }
+
+                auto member = size;
+                std::size_t memberPosition{};
+                Pattern rest = std::string{};
+
+                for (std::size_t x = 0; x < symbols.size(); x++)
+                {
+                    std::optional<std::string> symbolPattern;
+                    if (const auto* nt = std::get_if<0>(&symbols[x]))
+                    {
+                        if (const auto index = memberIndex(*nt); index < size)
+                        {
+                            if (member < size)
+                            {
+                                return {};
+                            }
+
+                            member = index;
+                            memberPosition = x;
+                            continue;
+                        }
+
+                        if (const auto it = patterns.find(*nt); it != patterns.end())
+                        {
+                            symbolPattern = it->second;
+                        }
+                    }
+                    else
+                    {
+                        symbolPattern = terminalPattern(std::get<1>(symbols[x]));
+                    }
+
+                    if (!symbolPattern)
+                    {
+                        return {};
+                    }
+
+                    rest = concatenation(rest, symbolPattern);
+                }
+
+                if (member == size)
+                {
+                    constants[i] = alternative(constants[i], rest);
+                    continue;
+                }
+
+                if (symbols.size() > 1)
+                {
+                    const bool right = memberPosition + 1 == symbols.size();
+                    if ((!right && memberPosition != 0) || (rightLinear && *rightLinear != right))
+                    {
+                        return {};
+                    }
+
+                    rightLinear = right;
+                }
+
+                coefficients[i][member] = alternative(coefficients[i][member], rest);
+            }
+        }
+
+        const auto ordered = [&](const Pattern& first, const Pattern& second) { return rightLinear.value_or(true) ? concatenation(first, second) : concatenation(second, first); };
+
+        std::vector<std::string> result;
+        for (std::size_t m = 0; m < size; m++)
+        {
+            auto a = coefficients;
+            auto b = constants;
+
+            for (std::size_t k = 0; k < size; k++)
+            {
+                if (k == m)
+                {
+                    continue;
+                }
+
+                const auto loop = repetition(a[k][k]);
+                for (std::size_t i = 0; i < size; i++)
+                {
+                    if (i == k || !a[i][k])
+                    {
+                        continue;
+                    }
+
+                    const auto through = ordered(a[i][k], loop);
+                    for (std::size_t j = 0; j < size; j++)
+                    {
+                        if (j != k)
+                        {
+                            a[i][j] = alternative(a[i][j], ordered(through, a[k][j]));
+                        }
+                    }
+
+                    b[i] = alternative(b[i], ordered(through, b[k]));
+                    a[i][k] = {};
+                }
+            }
+
+            const auto pattern = ordered(repetition(a[m][m]), b[m]);
+            if (!pattern || tooBig)
+            {
+                return {};
+            }
+
+            result.push_back(*pattern);
+        }
+
+        return result;
+    };
+
+    for (const auto& component : components)
+    {
+        tooBig = false;
+        if (const auto solved = solve(component))
+        {
+            for (std::size_t x = 0; x < component.size(); x++)
+            {
+                patterns.emplace(component[x], (*solved)[x]);
+            }
+        }
+    }
+
+    // Bytes that can follow each non-terminal
+    std::unordered_map<NT, typename Grammar<ParserTypes>::Lookahead> follows;
+    for (bool changed = true; changed;)
+    {
+        changed = false;
+
+        for (std::uint32_t dottedRule = 0; dottedRule < grammar.dottedRules.size(); dottedRule++)
+        {
+            const auto* nt = grammar.getPostdotNonTerminal(dottedRule);
+            if (!nt)
+            {
+                continue;
+            }
+
+            auto follow = grammar.firstSets[dottedRule + 1];
+            if (grammar.nullableSuffixes[dottedRule + 1])
+            {
+                follow |= follows[grammar.getRule(dottedRule).product];
+            }
+
+            auto& symbolFollow = follows[*nt];
+            if ((symbolFollow | follow) != symbolFollow)
+            {
+                symbolFollow |= follow;
+                changed = true;
+            }
+        }
+    }
+
+    // Bytes that can extend a match of each regular non-terminal, nullopt if it can't be replaced
+    std::unordered_map<NT, std::optional<RegexAutomaton::Bytes>> extendingBytes;
+    const auto getExtendingBytes = [&](const NT& symbol)
+    {
+        auto [it, inserted] = extendingBytes.try_emplace(symbol);
+        if (!inserted)
+        {
+            return it->second;
+        }
+
+        const auto pattern = patterns.find(symbol);
+        if (symbol != grammar.startSymbol && pattern != patterns.end() && !grammar.nullables.contains(symbol))
+        {
+            RegexAutomaton automaton;
+            if (automaton.add(pattern->second, 0))
+            {
+                it->second = automaton.extendingBytes();
+            }
+        }
+
+        return it->second;
+    };
+
+    typename Grammar<ParserTypes>::Lookahead skippedFirst;
+    if (skipper)
+    {
+        skippedFirst = TerminalLookahead<TerminalSymbol>::first(TerminalSymbol{skipper->regex});
+    }
+
+    // An occurrence is replaced if nothing that can follow it could extend its match
+    const auto isReplaceable = [&](std::uint32_t dottedRule)
+    {
+        const auto extending = getExtendingBytes(*grammar.getPostdotNonTerminal(dottedRule));
+        if (!extending)
+        {
+            return false;
+        }
+
+        auto follow = grammar.firstSets[dottedRule + 1] | skippedFirst;
+        if (grammar.nullableSuffixes[dottedRule + 1])
+        {
+            follow |= follows[grammar.getRule(dottedRule).product];
+        }
+
+        return (*extending & follow).none();
+    };
+
+    // Only the rules the parser can still reach are rewritten, the sub-grammars of the replaced non-terminals are left as they are
+    auto rules = grammar.rules;
+    std::vector<std::tuple<std::size_t, std::size_t, NT>> replacements;
+
+    std::unordered_set<NT> visited{grammar.startSymbol};
+    std::vector<NT> pending{grammar.startSymbol};
+    while (!pending.empty())
+    {
+        const auto symbol = pending.back();
+        pending.pop_back();
+
+        for (const auto* rule : productRules[symbol])
+        {
+            for (std::size_t x = 0; x < rule->symbols.size(); x++)
+            {
+                const auto* nt = std::get_if<0>(&rule->symbols[x]);
+                if (!nt)
+                {
+                    continue;
+                }
+
+                if (isReplaceable(grammar.ruleToDottedRule[rule->id] + x))
+                {
+                    rules[rule->id].symbols[x] = typename RuleT::Symbol{std::in_place_index<1>, RegexTerminalSymbol{patterns.at(*nt)}};
+                    replacements.emplace_back(rule->id, x, *nt);
+                }
+                else if (visited.insert(*nt).second)
+                {
+                    pending.push_back(*nt);
+                }
+            }
+        }
+    }
+
+    if (replacements.empty())
+    {
+        return grammar;
+    }
+
+    Grammar<ParserTypes> result{grammar.startSymbol, std::move(rules)};
+    result.expansions.resize(result.dottedRules.size());
+
+    const auto hasActions = [&](const NT& symbol)
+    {
+        std::unordered_set<NT> seen{symbol};
+        std::vector<NT> symbols{symbol};
+        while (!symbols.empty())
+        {
+            const auto current = symbols.back();
+            symbols.pop_back();
+
+            for (const auto* rule : productRules[current])
+            {
+                if (rule->id < semantics.actions.size() && semantics.actions[rule->id])
+                {
+                    return true;
+                }
+
+                for (const auto& ruleSymbol : rule->symbols)
+                {
+                    if (const auto* nt = std::get_if<0>(&ruleSymbol); nt && seen.insert(*nt).second)
+                    {
+                        symbols.push_back(*nt);
+                    }
+                }
+            }
+        }
+
+        return false;
+    };
+
+    // The grammar as written is shared by the expansions, each one starts from its own non-terminal
+    std::shared_ptr<const Grammar<ParserTypes>> expansionGrammar;
+    std::unordered_map<NT, bool> expanded;
+    for (const auto& [ruleId, x, symbol] : replacements)
+    {
+        auto [it, inserted] = expanded.try_emplace(symbol);
+        if (inserted)
+        {
+            it->second = hasActions(symbol);
+        }
+
+        if (!it->second)
+        {
+            continue;
+        }
+
+        if (!expansionGrammar)
+        {
+            expansionGrammar = std::make_shared<const Grammar<ParserTypes>>(grammar);
+        }
+
+        const auto dottedRule = grammar.ruleToDottedRule[ruleId] + x;
+        result.expansions[dottedRule] = typename Grammar<ParserTypes>::Expansion{expansionGrammar, {symbol, grammar.dottedRuleToPrediction[dottedRule]}};
+    }
+
+    return result;
+}
+
+} // namespace StringGrammar
 
 template <typename ParserTypes>
 struct StringGrammarBuilder
@@ -163,8 +967,17 @@ struct StringGrammarBuilder
     std::vector<Rule<ParserTypes>> rules;
     Semantics<ParserTypes> semantics;
 
+    // Regular non-terminals are matched like terminals by the parsers it makes, see StringGrammar::lexicalize
+    // Off by default, the replaced non-terminals without semantic actions are single leaves in the tree
+    bool lexicalize = false;
+
     using Str = StringGrammar::Str;
 
+    // Regex skipped before each terminal by the parsers it makes, like whitespace and comments, see Parser::skipper
+    // Unlike the whitespace symbol nothing is added to the rules, the chart has no item for what it skips
+    // It's skipped in full before every terminal, a token that can contain it, like a string literal, has to be a single terminal
+    std::optional<Str> skipPattern;
+
     StringGrammarBuilder(NT startSymbol, std::optional<NT> whitespaceSymbol = {}) : startSymbol{startSymbol}, whitespaceSymbol{whitespaceSymbol}
     {
 
@@ -205,6 +1018,68 @@ struct StringGrammarBuilder
         }
     };
 
+    // Pass the same automaton to share it between grammars, each builder made from a word list has its own
+    struct Dictionary : public StringSymbolBuilder
+    {
+        explicit Dictionary(Str name, std::shared_ptr<const DictionaryAutomaton> automaton) : StringSymbolBuilder(StringGrammar::DictionaryTerminalSymbol{std::move(name), std::move(automaton)})
+        {
+        }
+
+        explicit Dictionary(Str name, std::vector<Str> words) : Dictionary(std::move(name), std::make_shared<const DictionaryAutomaton>(std::move(words)))
+        {
+        }
+    };
+
+    // Bytes written like the inside of a regex bracket, Class{"0-9a-f"} matches one of them and Class{"0-9a-f"}.plus() a run
+    // Classes combine with | and ~ before plus(), | throws if only one side was made with plus()
+    struct Class : public StringSymbolBuilder
+    {
+        explicit Class(std::string_view spec) : StringSymbolBuilder(StringGrammar::ClassTerminalSymbol::parse(spec))
+        {
+        }
+
+        explicit Class(const StringGrammar::ClassTerminalSymbol& symbol) : StringSymbolBuilder(symbol)
+        {
+        }
+
+        Class plus() const
+        {
+            return Class{StringGrammar::ClassTerminalSymbol{bytes(), true}};
+        }
+
+        // Both sides must repeat or not, combine the classes before calling plus()
+        Class operator|(const Class& other) const
+        {
+            if (repeats() != other.repeats())
+            {
+                throw std::invalid_argument("invalid class, combining a plus() class with a single byte one");
+            }
+
+            return Class{StringGrammar::ClassTerminalSymbol{bytes() | other.bytes(), repeats()}};
+        }
+
+        Class operator~() const
+        {
+            if (bytes().all())
+            {
+                throw std::invalid_argument("invalid class, the complement of every byte is empty");
+            }
+
+            return Class{StringGrammar::ClassTerminalSymbol{~bytes(), repeats()}};
+        }
+
+      private:
+        const StringGrammar::ClassTerminalSymbol::Bytes& bytes() const
+        {
+            return std::get<StringGrammar::ClassTerminalSymbol>(this->symbol).bytes;
+        }
+
+        bool repeats() const
+        {
+            return std::get<StringGrammar::ClassTerminalSymbol>(this->symbol).repeat;
+        }
+    };
+
     struct RuleBuilder
     {
         StringGrammarBuilder& grammarBuilder;
@@ -307,12 +1182,27 @@ struct StringGrammarBuilder
 
     Parser<ParserTypes> makeParser() const
     {
-        return 
+        Grammar<ParserTypes> grammar{startSymbol, rules};
+
+        std::optional<StringGrammar::RegexSkipper> skipper;
+        if (skipPattern)
         {
-            Grammar<ParserTypes>{startSymbol, rules},
-            &StringGrammar::match,
+            skipper = StringGrammar::RegexSkipper{*skipPattern};
+        }
+
+        Parser<ParserTypes> parser
+        {
+            lexicalize ? StringGrammar::lexicalize(grammar, semantics, skipper) : std::move(grammar),
+            StringGrammar::Matcher{},
             semantics,
         };
+
+        if (skipper)
+        {
+            parser.skipper = *skipper;
+        }
+
+        return parser;
     }
 };
 
@@ -1,7 +1,9 @@
 #pragma once
 
+#include <concepts>
 #include <iostream>
 #include <string_view>
+#include <variant>
 
 namespace larley
 {
@@ -57,4 +59,11 @@ struct overloaded : Ts...
     using Ts::operator()...;
 };
 
+// std::equality_comparable holds for any std::variant, even when comparing its alternatives wouldn't compile
+template <typename T>
+constexpr bool isEqualityComparable = std::equality_comparable<T>;
+
+template <typename... Ts>
+constexpr bool isEqualityComparable<std::variant<Ts...>> = (isEqualityComparable<Ts> && ...);
+
 } // namespace larley
\ No newline at end of file
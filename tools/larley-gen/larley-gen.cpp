@@ -0,0 +1,472 @@
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "larley/meta-grammar.hpp"
+
+// Emits a header with a parser for a grammar written in the meta grammar text format, see larley/meta-grammar.hpp
+// The grammar's tables are written out and its recognizer is parseChart with a Dispatch made of switches over its dotted
+// rules, predictions and terminals instead of the grammar's vectors, it plugs into Parser as its recognizer
+//
+//   larley-gen <grammar.txt> <output.hpp> <namespace>
+
+using namespace larley;
+using namespace larley::MetaGrammar;
+
+namespace
+{
+
+constexpr auto none = std::numeric_limits<std::uint32_t>::max();
+
+std::string charLiteral(char c)
+{
+    if (c == '\'' || c == '\\')
+    {
+        return std::string{"'\\"} + c + "'";
+    }
+
+    if (c >= 0x20 && c < 0x7f)
+    {
+        return std::string{"'"} + c + "'";
+    }
+
+    constexpr std::string_view digits = "0123456789abcdef";
+    const auto byte = static_cast<unsigned char>(c);
+    return std::string{"'\\x"} + digits[byte / 16] + digits[byte % 16] + "'";
+}
+
+// Hex escapes are split from what follows so that a digit after one isn't read as part of it
+std::string stringLiteral(std::string_view str)
+{
+    std::string result = "\"";
+    for (const auto c : str)
+    {
+        if (c == '"' || c == '\\')
+        {
+            result += '\\';
+            result += c;
+        }
+        else if (c >= 0x20 && c < 0x7f)
+        {
+            result += c;
+        }
+        else
+        {
+            constexpr std::string_view digits = "0123456789abcdef";
+            const auto byte = static_cast<unsigned char>(c);
+            result += "\\x";
+            result += digits[byte / 16];
+            result += digits[byte % 16];
+            result += "\" \"";
+        }
+    }
+
+    return result + "\"";
+}
+
+// The meta grammar only makes literals, choices and ranges, the other kinds have no generated matcher
+[[noreturn]] void unsupportedTerminal(const StringGrammar::TerminalSymbol& terminal)
+{
+    std::ostringstream os;
+    os << "unsupported terminal " << terminal << ", only literals, choices and ranges can be generated";
+    throw std::invalid_argument(os.str());
+}
+
+// Names end up as enumerators and in the namespace, the meta grammar's identifiers can still be keywords or reserved names
+bool validIdentifier(std::string_view name)
+{
+    constexpr std::string_view keywords[]{
+        "alignas", "alignof", "and", "and_eq", "asm", "auto", "bitand", "bitor", "bool", "break", "case", "catch", "char", "char8_t", "char16_t",
+        "char32_t", "class", "compl", "concept", "const", "consteval", "constexpr", "constinit", "const_cast", "continue", "co_await", "co_return",
+        "co_yield", "decltype", "default", "delete", "do", "double", "dynamic_cast", "else", "enum", "explicit", "export", "extern", "false", "float",
+        "for", "friend", "goto", "if", "inline", "int", "long", "mutable", "namespace", "new", "noexcept", "not", "not_eq", "nullptr", "operator", "or",
+        "or_eq", "private", "protected", "public", "register", "reinterpret_cast", "requires", "return", "short", "signed", "sizeof", "static",
+        "static_assert", "static_cast", "struct", "switch", "template", "this", "thread_local", "throw", "true", "try", "typedef", "typeid",
+        "typename", "union", "unsigned", "using", "virtual", "void", "volatile", "wchar_t", "while", "xor", "xor_eq"};
+
+    const auto isStart = [](char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_'; };
+    const auto isPart = [&](char c) { return isStart(c) || (c >= '0' && c <= '9'); };
+
+    if (name.empty() || !isStart(name[0]) || !std::ranges::all_of(name, isPart))
+    {
+        return false;
+    }
+
+    // Reserved for the implementation
+    if (name.find("__") != std::string_view::npos || (name[0] == '_' && name.size() > 1 && name[1] >= 'A' && name[1] <= 'Z'))
+    {
+        return false;
+    }
+
+    return !std::ranges::contains(keywords, name);
+}
+
+std::string terminalExpression(const StringGrammar::TerminalSymbol& terminal)
+{
+    using namespace StringGrammar;
+
+    if (const auto* symbol = std::get_if<LiteralTerminalSymbol>(&terminal))
+    {
+        return "LiteralTerminalSymbol{" + stringLiteral(*symbol) + "}";
+    }
+    else if (const auto* symbol = std::get_if<ChoiceTerminalSymbol>(&terminal))
+    {
+        std::string result = "ChoiceTerminalSymbol{";
+        for (std::size_t x = 0; x < symbol->size(); x++)
+        {
+            result += (x ? ", " : "") + stringLiteral((*symbol)[x]);
+        }
+
+        return result + "}";
+    }
+    else if (const auto* symbol = std::get_if<RangeTerminalSymbol>(&terminal))
+    {
+        return "RangeTerminalSymbol{" + stringLiteral(symbol->first) + ", " + stringLiteral(symbol->second) + "}";
+    }
+
+    unsupportedTerminal(terminal);
+}
+
+// Statements returning the length StringGrammar::match would, `src` and `index` being the parameters of Dispatch::match
+std::string matchStatements(const StringGrammar::TerminalSymbol& terminal)
+{
+    using namespace StringGrammar;
+
+    std::ostringstream os;
+    if (const auto* symbol = std::get_if<LiteralTerminalSymbol>(&terminal))
+    {
+        os << "                return src.substr(index).starts_with(" << stringLiteral(*symbol) << ") ? " << symbol->size() << " : -1;\n";
+    }
+    else if (const auto* symbol = std::get_if<ChoiceTerminalSymbol>(&terminal))
+    {
+        // The first partial that matches, like match
+        for (const auto& partial : *symbol)
+        {
+            os << "                if (src.substr(index).starts_with(" << stringLiteral(partial) << "))\n";
+            os << "                {\n";
+            os << "                    return " << partial.size() << ";\n";
+            os << "                }\n";
+        }
+
+        os << "                return -1;\n";
+    }
+    else if (const auto* symbol = std::get_if<RangeTerminalSymbol>(&terminal))
+    {
+        os << "                return index < src.size() && src[index] >= " << charLiteral(symbol->first[0]) << " && src[index] <= " << charLiteral(symbol->second[0]) << " ? 1 : -1;\n";
+    }
+    else
+    {
+        unsupportedTerminal(terminal);
+    }
+
+    return os.str();
+}
+
+template <typename T>
+void writeList(std::ostream& os, const std::vector<T>& values, const auto& write)
+{
+    os << '{';
+    for (std::size_t x = 0; x < values.size(); x++)
+    {
+        os << (x ? ", " : "");
+        write(values[x]);
+    }
+    os << '}';
+}
+
+void writeIds(std::ostream& os, const std::vector<std::uint32_t>& ids)
+{
+    writeList(os, ids, [&](std::uint32_t id) { os << (id == none ? "none" : std::to_string(id)); });
+}
+
+void writeHeader(std::ostream& os, const Grammar<GenPT>& grammar, std::string_view grammarPath, std::string_view ns)
+{
+    // Nested namespaces are written a::b
+    for (std::size_t begin = 0;;)
+    {
+        const auto end = ns.find("::", begin);
+        if (!validIdentifier(ns.substr(begin, end - begin)))
+        {
+            throw std::invalid_argument("invalid namespace " + std::string(ns));
+        }
+
+        if (end == std::string_view::npos)
+        {
+            break;
+        }
+
+        begin = end + 2;
+    }
+
+    // Products first so that they keep the order of the text, then the names that are only used
+    std::vector<std::string> nonTerminals;
+    const auto addNonTerminal = [&](const std::string& name)
+    {
+        if (!validIdentifier(name))
+        {
+            throw std::invalid_argument("invalid non-terminal name " + name + ", it has to be a C++ identifier");
+        }
+
+        if (!std::ranges::contains(nonTerminals, name))
+        {
+            nonTerminals.push_back(name);
+        }
+    };
+
+    for (const auto& rule : grammar.rules)
+    {
+        addNonTerminal(rule.product);
+    }
+
+    for (const auto& rule : grammar.rules)
+    {
+        for (const auto& symbol : rule.symbols)
+        {
+            if (const auto* nt = std::get_if<0>(&symbol))
+            {
+                addNonTerminal(*nt);
+            }
+        }
+    }
+
+    os << "// Generated by larley-gen from " << grammarPath << ", edit the grammar instead\n";
+    os << "#pragma once\n\n";
+    os << "#include <cstdint>\n#include <limits>\n#include <ostream>\n#include <string_view>\n#include <vector>\n\n";
+    os << "#include \"larley/parser.hpp\"\n#include \"larley/string-grammar.hpp\"\n\n";
+    os << "namespace " << ns << "\n{\n\n";
+
+    os << "enum class NonTerminal : std::uint32_t\n{\n";
+    for (const auto& name : nonTerminals)
+    {
+        os << "    " << name << ",\n";
+    }
+    os << "};\n\n";
+
+    // For the printers
+    os << "inline std::ostream& operator<<(std::ostream& os, NonTerminal nonTerminal)\n{\n";
+    os << "    constexpr std::string_view names[]{";
+    for (std::size_t x = 0; x < nonTerminals.size(); x++)
+    {
+        os << (x > 0 ? ", " : "") << "\"" << nonTerminals[x] << "\"";
+    }
+    os << "};\n";
+    os << "    return os << names[static_cast<std::uint32_t>(nonTerminal)];\n}\n\n";
+
+    os << "using Types = ParserTypes<NonTerminal, larley::StringGrammar::TerminalSymbol, std::string_view, void, std::uint32_t, larley::StringGrammar::Matcher>;\n\n";
+    os << "// Rule ids are the order of the rules in the grammar, what Semantics::setAction takes\n";
+    os << "inline constexpr std::size_t ruleCount = " << grammar.rules.size() << ";\n\n";
+
+    // The grammar, its tables written out
+    os << "template <typename ParserTypes = Types>\n";
+    os << "larley::Grammar<ParserTypes> grammar()\n{\n";
+    os << "    using namespace larley::StringGrammar;\n";
+    os << "    using RuleT = larley::Rule<ParserTypes>;\n";
+    os << "    using Symbol = RuleT::Symbol;\n\n";
+    os << "    [[maybe_unused]] constexpr auto none = std::numeric_limits<std::uint32_t>::max();\n\n";
+
+    os << "    std::vector<RuleT> rules;\n";
+    os << "    rules.reserve(ruleCount);\n";
+    for (const auto& rule : grammar.rules)
+    {
+        os << "    rules.push_back({NonTerminal::" << rule.product << ", {";
+        for (std::size_t x = 0; x < rule.symbols.size(); x++)
+        {
+            os << (x ? ", " : "");
+            if (const auto* nt = std::get_if<0>(&rule.symbols[x]))
+            {
+                os << "Symbol{std::in_place_index<0>, NonTerminal::" << *nt << "}";
+            }
+            else
+            {
+                os << "Symbol{std::in_place_index<1>, " << terminalExpression(std::get<1>(rule.symbols[x])) << "}";
+            }
+        }
+        os << "}, " << rule.id << ", 0});\n";
+    }
+    os << "\n";
+
+    os << "    typename larley::Grammar<ParserTypes>::Tables tables;\n";
+
+    std::vector<std::string> nullables;
+    for (const auto& name : nonTerminals)
+    {
+        if (grammar.nullables.contains(name))
+        {
+            nullables.push_back(name);
+        }
+    }
+
+    os << "    tables.nullables = ";
+    writeList(os, nullables, [&](const std::string& name) { os << "NonTerminal::" << name; });
+    os << ";\n";
+
+    os << "    tables.dottedRules = ";
+    writeList(os, grammar.dottedRules, [&](const auto& dottedRule) { os << '{' << dottedRule.rule << ", " << dottedRule.dot << '}'; });
+    os << ";\n";
+
+    os << "    tables.ruleToDottedRule = ";
+    writeIds(os, grammar.ruleToDottedRule);
+    os << ";\n";
+
+    os << "    tables.predictions = ";
+    writeList(os, grammar.predictions, [&](const auto& prediction) { writeIds(os, prediction); });
+    os << ";\n";
+
+    os << "    tables.dottedRuleToPrediction = ";
+    writeIds(os, grammar.dottedRuleToPrediction);
+    os << ";\n";
+
+    os << "    tables.startPrediction = " << grammar.startPrediction << ";\n";
+
+    os << "    tables.terminalIds = ";
+    writeIds(os, grammar.terminalIds);
+    os << ";\n";
+
+    os << "    tables.terminalCount = " << grammar.terminalCount << ";\n\n";
+
+    os << "    return {NonTerminal::" << grammar.startSymbol << ", std::move(rules), std::move(tables)};\n";
+    os << "}\n\n";
+
+    // The dispatch, the same answers as larley::GrammarDispatch gets from the tables
+    os << "// parseChart's lookups as switches over this grammar's dotted rules, predictions and terminals, see larley::GrammarDispatch\n";
+    os << "template <typename ParserTypes>\n";
+    os << "struct Dispatch\n{\n";
+    os << "    const larley::Grammar<ParserTypes>& grammar;\n";
+    os << "    const typename ParserTypes::Matcher& matcher;\n\n";
+
+    const GenPT::Matcher matcher;
+    const GrammarDispatch<GenPT> tables{grammar, matcher};
+
+    os << "    static larley::PostdotKind kind(std::uint32_t dottedRule)\n    {\n";
+    os << "        switch (dottedRule)\n        {\n";
+    for (const auto& [kind, name] : {std::pair{PostdotKind::NonTerminal, "NonTerminal"}, std::pair{PostdotKind::NullableNonTerminal, "NullableNonTerminal"}, std::pair{PostdotKind::Terminal, "Terminal"}})
+    {
+        bool any = false;
+        for (std::uint32_t x = 0; x < grammar.dottedRules.size(); x++)
+        {
+            if (tables.kind(x) == kind)
+            {
+                os << "            case " << x << ":\n";
+                any = true;
+            }
+        }
+
+        if (any)
+        {
+            os << "                return larley::PostdotKind::" << name << ";\n";
+        }
+    }
+    os << "            default:\n";
+    os << "                return larley::PostdotKind::Complete;\n";
+    os << "        }\n    }\n\n";
+
+    os << "    static void forEachPredicted(std::uint32_t prediction, const auto& onPredicted)\n    {\n";
+    os << "        switch (prediction)\n        {\n";
+    for (std::size_t x = 0; x < grammar.predictions.size(); x++)
+    {
+        os << "            case " << x << ":\n";
+        for (const auto dottedRule : grammar.predictions[x])
+        {
+            os << "                onPredicted(" << dottedRule << ");\n";
+        }
+        os << "                return;\n";
+    }
+    os << "        }\n    }\n\n";
+
+    os << "    static int match(std::string_view src, std::size_t index, std::uint32_t terminalId, const auto&)\n    {\n";
+    os << "        switch (terminalId)\n        {\n";
+    std::vector<bool> written(grammar.terminalCount);
+    for (std::uint32_t x = 0; x < grammar.dottedRules.size(); x++)
+    {
+        const auto terminalId = grammar.terminalIds[x];
+        if (terminalId == grammar.noTerminal || written[terminalId])
+        {
+            continue;
+        }
+
+        written[terminalId] = true;
+
+        const auto& terminal = std::get<1>(*grammar.getPostdotSymbol(x));
+        os << "            case " << terminalId << ":\n            {\n";
+        os << matchStatements(terminal);
+        os << "            }\n";
+    }
+    os << "        }\n\n";
+    os << "        return -1;\n";
+    os << "    }\n";
+    os << "};\n\n";
+
+    os << "// parseChart with the Dispatch above, the chart is the same as the generic one's\n";
+    os << "template <typename ParserTypes = Types>\n";
+    os << "larley::ParseChart<ParserTypes> recognize(const larley::Grammar<ParserTypes>& grammar, const typename ParserTypes::Matcher& matcher, typename ParserTypes::Src src, const typename ParserTypes::Skipper& skipper, larley::ChartMode mode)\n";
+    os << "{\n";
+    os << "    return larley::parseChart<ParserTypes, Dispatch<ParserTypes>>(grammar, matcher, src, skipper, mode);\n";
+    os << "}\n\n";
+
+    os << "// Reset its recognizer to get the generic engine back, the semantics stay the same\n";
+    os << "template <typename ParserTypes = Types>\n";
+    os << "larley::Parser<ParserTypes> makeParser()\n{\n";
+    os << "    larley::Parser<ParserTypes> parser{grammar<ParserTypes>(), larley::StringGrammar::Matcher{}};\n";
+    os << "    parser.recognizer = recognize<ParserTypes>;\n";
+    os << "    return parser;\n";
+    os << "}\n\n";
+
+    os << "} // namespace " << ns << "\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc != 4)
+    {
+        std::cerr << "usage: larley-gen <grammar.txt> <output.hpp> <namespace>\n";
+        return 2;
+    }
+
+    std::ifstream input{argv[1]};
+    if (!input)
+    {
+        std::cerr << "larley-gen: can't read " << argv[1] << "\n";
+        return 1;
+    }
+
+    const std::string text{std::istreambuf_iterator<char>{input}, {}};
+
+    const auto rules = parseRules(text);
+    if (!rules || rules->empty())
+    {
+        std::cerr << "larley-gen: " << argv[1] << " isn't a valid grammar\n";
+        return 1;
+    }
+
+    const Grammar<GenPT> grammar{rules->front().product, *rules};
+
+    std::ostringstream os;
+    try
+    {
+        writeHeader(os, grammar, argv[1], argv[3]);
+    }
+    catch (const std::invalid_argument& error)
+    {
+        std::cerr << "larley-gen: " << argv[1] << ", " << error.what() << "\n";
+        return 1;
+    }
+
+    std::ofstream output{argv[2]};
+    output << os.str();
+    if (!output)
+    {
+        std::cerr << "larley-gen: can't write " << argv[2] << "\n";
+        return 1;
+    }
+
+    return 0;
+}